@@ -2,11 +2,125 @@
 #define CUBE_HPP
 
 #include <array>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 using namespace std;
 
 
+constexpr array<array<char, 3>, 8> corner_colours = {{
+    // sticker colours of each piece, white/yellow first, in the order draw() reads them ((orientation + k) % 3)
+    {'W', 'B', 'O'},
+    {'W', 'R', 'B'},
+    {'W', 'G', 'R'},
+    {'W', 'O', 'G'},
+    {'Y', 'G', 'O'},
+    {'Y', 'R', 'G'},
+    {'Y', 'B', 'R'},
+    {'Y', 'O', 'B'}
+}};
+
+/*
+ * Scramble parsing
+ *
+ * parse_scramble turns text into move indices, without copying the text (the caller's vector gets reused)
+ *      0 - 17 = moves, in cube::apply_move order
+ *      18 - 26 = rotations, cube::apply_rotation order + 18
+ * A move is a face letter (or x, y, z) with an optional 2 or ' after it ("2'" is read as 2),
+ * spaces between moves are optional
+ * Anything else stops the parse, with the byte offset and what was wrong
+ */
+
+struct scramble_error {
+    size_t offset = 0;
+    const char *reason = nullptr; // nullptr = no error
+};
+
+constexpr array<int8_t, 256> make_move_letters() {
+    array<int8_t, 256> letters{};
+    for (int c = 0; c < 256; c++) letters[c] = -1;
+    letters['F'] = 0;
+    letters['D'] = 3;
+    letters['R'] = 6;
+    letters['L'] = 9;
+    letters['B'] = 12;
+    letters['U'] = 15;
+    letters['z'] = 18;
+    letters['x'] = 21;
+    letters['y'] = 24;
+    return letters;
+}
+
+inline constexpr array<int8_t, 256> move_letters = make_move_letters();
+
+inline bool parse_scramble(string_view text, vector<uint8_t> &moves, scramble_error &error) {
+    moves.clear();
+    size_t n = text.size();
+    for (size_t i = 0; i < n;) {
+        char ch = text[i];
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+            i++;
+            continue;
+        }
+        int move = move_letters[(uint8_t) ch];
+        if (move < 0) {
+            error = {i, ch == '2' || ch == '\'' ? "turn amount without a face" : "not a move"};
+            return false;
+        }
+        i++;
+        if (i < n && text[i] == '2') {
+            move += 1;
+            i++;
+            if (i < n && text[i] == '\'') i++;
+        }
+        else if (i < n && text[i] == '\'') {
+            move += 2;
+            i++;
+        }
+        moves.push_back(move);
+    }
+    error = {};
+    return true;
+}
+
+/*
+ * Facelet input
+ *
+ * 24 sticker colours (W, Y, G, B, R, O), face by face in the order U R F D L B,
+ * each face row by row as seen from outside, U and D with F closest to the middle of the net, sides with U on top
+ * i.e. the same net cube::draw prints, with the side faces read from the point of view of that face
+ *
+ * facelet_stickers[i] = (position, k): sticker i is sticker k of the corner at that position,
+ * so it shows corner_colours[piece][(orientation + k) % 3]
+ */
+
+constexpr array<array<uint8_t, 2>, 24> facelet_stickers = {{
+    {0, 0}, {1, 0}, {3, 0}, {2, 0}, // U
+    {2, 2}, {1, 1}, {5, 1}, {6, 2}, // R
+    {3, 2}, {2, 1}, {4, 1}, {5, 2}, // F
+    {4, 0}, {5, 0}, {7, 0}, {6, 0}, // D
+    {0, 2}, {3, 1}, {7, 1}, {4, 2}, // L
+    {1, 2}, {0, 1}, {6, 1}, {7, 2}  // B
+}};
+
+inline bool looks_like_facelets(string_view text) {
+    // 24 colour letters, at least one of which can't be a move (B and R can be both)
+    if (text.size() != 24) return false;
+    bool colour_only = false;
+    for (char ch : text) {
+        if (ch != 'W' && ch != 'Y' && ch != 'G' && ch != 'B' && ch != 'R' && ch != 'O') return false;
+        colour_only |= ch != 'B' && ch != 'R';
+    }
+    return colour_only;
+}
+
 class cube {
         /*
          * Positions for the cubies: (U = top, D = bottom, R = right, L = left, F = front, B = back)
@@ -52,16 +166,7 @@ class cube {
             // 0 = WBO, 1 = WRB, 2 = WGR, 3 = WOG, 4 = YGO, 5 = YRG, 6 = YBR, 7 = YOB
             //
 
-            array<array<char, 3>, 8> colours = {{
-                {'W', 'B', 'O'},
-                {'W', 'R', 'B'},
-                {'W', 'G', 'R'},
-                {'W', 'O', 'G'},
-                {'Y', 'G', 'O'},
-                {'Y', 'R', 'G'},
-                {'Y', 'B', 'R'},
-                {'Y', 'O', 'B'}
-            }};
+            const array<array<char, 3>, 8> &colours = corner_colours;
 
             printf("      ┌─────┐\n");
             printf("      │ %c %c │\n", colours[pieces[0]][orientations[0]], colours[pieces[1]][orientations[1]]);
@@ -94,7 +199,7 @@ class cube {
             printf("      └─────┘\n");
         }
 
-        void apply_move(int move) { //applies a face turn move to the cube
+        constexpr void apply_move(int move) { //applies a face turn move to the cube
 
             // 0 = F, 1 = F2, 2 = F'   
             if (move == 0) { rot1(2, 3, 4, 5); return; }
@@ -128,7 +233,7 @@ class cube {
 
         }
 
-        void apply_rotation(int rotation) { 
+        constexpr void apply_rotation(int rotation) { 
             //applies rotation to the cube
 
             //z = 0
@@ -232,83 +337,92 @@ class cube {
         }
 
 
-        void rotate_to_wca() { 
-            //rotates the cube so that white top, green front
-            switch(find_orientation()) {
-                case 0: break;
-                case 1: apply_rotation(0); apply_rotation(8); break;
-                case 2: apply_rotation(3); apply_rotation(6); break;
-                case 3: apply_rotation(8); break;
-                case 4: apply_rotation(3); apply_rotation(7); break;
-                case 5: apply_rotation(2); break;
-                case 6: apply_rotation(7); break;
-                case 7: apply_rotation(2); apply_rotation(6); break;
-                case 8: apply_rotation(2); apply_rotation(5); break;
-                case 9: apply_rotation(6); break;
-                case 10: apply_rotation(5); break;
-                case 11: apply_rotation(2); apply_rotation(4); break;
-                case 12: apply_rotation(4); break;
-                case 13: apply_rotation(0); apply_rotation(6); break;
-                case 14: apply_rotation(0); apply_rotation(5); break;
-                case 15: apply_rotation(1); apply_rotation(6); break;
-                case 16: apply_rotation(5); apply_rotation(7); break;
-                case 17: apply_rotation(2); apply_rotation(7); break;
-                case 18: apply_rotation(1); break;
-                case 19: apply_rotation(2); apply_rotation(8); break;
-                case 20: apply_rotation(3); apply_rotation(8); break;
-                case 21: apply_rotation(4); apply_rotation(6); break;
-                case 22: apply_rotation(3); break;
-                case 23: apply_rotation(0); break;
+        void rotate_to_wca(); // white top, green front (one table lookup, defined after wca_transforms)
+
+
+        void apply_moves(const uint8_t *moves, size_t n) {
+            // move indices from parse_scramble
+            for (size_t i = 0; i < n; i++) {
+                if (moves[i] < 18) apply_move(moves[i]);
+                else apply_rotation(moves[i] - 18);
             }
         }
 
+        bool apply_scramble(string_view scramble, scramble_error &error) {
+            // reads scramble and applies moves to the cube, nothing is applied if it doesn't parse
+            thread_local vector<uint8_t> moves;
+            if (!parse_scramble(scramble, moves, error)) return false;
+            apply_moves(moves.data(), moves.size());
+            return true;
+        }
 
-        void apply_scramble(string scramble) {
-            // reads scramble and applies moves to the cube
+        bool apply_scramble(string_view scramble) {
+            scramble_error error;
+            return apply_scramble(scramble, error);
+        }
 
+        bool set_facelets(string_view facelets, scramble_error &error) {
+            // cube from the 24 sticker form (see facelet_stickers), unchanged if it isn't a real cube
 
-            for (int i = 0; i < scramble.size(); i++) {
-                int move = -1;
-                int rot = -1;
-                if (scramble[i] == 'F') move = 0;
-                if (scramble[i] == 'D') move = 3;
-                if (scramble[i] == 'R') move = 6;
-                if (scramble[i] == 'L') move = 9;
-                if (scramble[i] == 'B') move = 12;
-                if (scramble[i] == 'U') move = 15;
-                if (scramble[i] == 'z') rot = 0;
-                if (scramble[i] == 'x') rot = 3;
-                if (scramble[i] == 'y') rot = 6;
+            if (facelets.size() != 24) {
+                error = {min(facelets.size(), (size_t) 24), "facelets need exactly 24 stickers"};
+                return false;
+            }
+            array<array<char, 3>, 8> stickers;
+            array<size_t, 8> first = {24, 24, 24, 24, 24, 24, 24, 24}; // offset of each corner's first sticker
+            for (size_t i = 0; i < 24; i++) {
+                stickers[facelet_stickers[i][0]][facelet_stickers[i][1]] = facelets[i];
+                first[facelet_stickers[i][0]] = min(first[facelet_stickers[i][0]], i);
+            }
 
-                if (scramble[i+1] == '2') {
-                    if (move >= 0) move += 1;
-                    else rot += 1;
+            cube c{};
+            unsigned seen = 0;
+            int twist = 0;
+            for (int pos = 0; pos < 8; pos++) {
+                int found = -1;
+                for (int p = 0; p < 8 && found < 0; p++) {
+                    for (int o = 0; o < 3; o++) {
+                        if (corner_colours[p][o] == stickers[pos][0] && corner_colours[p][(o + 1) % 3] == stickers[pos][1] &&
+                            corner_colours[p][(o + 2) % 3] == stickers[pos][2]) {
+                            found = p;
+                            c.orientations[pos] = o;
+                        }
+                    }
                 }
-                if (scramble[i+1] == '\'') { 
-                    if (move >= 0) move += 2;
-                    else rot += 2; 
+                if (found < 0) {
+                    error = {first[pos], "no corner has these colours"};
+                    return false;
                 }
-
-                if (move >= 0) apply_move(move);
-                if (rot >= 0) apply_rotation(rot);
+                if (seen >> found & 1) {
+                    error = {first[pos], "corner appears twice"};
+                    return false;
+                }
+                seen |= 1u << found;
+                c.pieces[pos] = found;
+                twist += c.orientations[pos];
+            }
+            if (twist % 3) {
+                error = {0, "a corner is twisted in place (orientations don't add up)"};
+                return false;
             }
-            return;
+            pieces = c.pieces;
+            orientations = c.orientations;
+            error = {};
+            return true;
         }
 
         //Finds orientation of cube
-        int find_orientation() {
-            int orientation;
-            int i;
-            for (i = 0; pieces[i] != 0; i++);
-            orientation = (3 * i) + orientations[i];
-            return orientation;
+        constexpr int find_orientation() const {
+            int i = 0;
+            while (pieces[i] != 0) i++;
+            return (3 * i) + orientations[i];
         }
 
 
 
 
     private:
-        void rot2(int p1, int p2, int p3, int p4) {
+        constexpr void rot2(int p1, int p2, int p3, int p4) {
             // helper function to apply a double turn, R2 L2 etc
             int temp = pieces[p4];
             pieces[p4] = pieces[p2];
@@ -324,7 +438,7 @@ class cube {
             orientations[p1] = temp;
         };
 
-        void rot1(int p1, int p2, int p3, int p4) {
+        constexpr void rot1(int p1, int p2, int p3, int p4) {
             //for selecting pieces, select p1 towards rotating side, p2 against direction of rotation and go on
             //helper function to apply R, L, B, F
             int temp = pieces[p4];
@@ -339,7 +453,7 @@ class cube {
             orientations[p3] = (temp + 1) % 3;
         };
 
-        void rot_ud(int p1, int p2, int p3, int p4) {
+        constexpr void rot_ud(int p1, int p2, int p3, int p4) {
             // helper function to apply U and D
             int temp = pieces[p4];
             pieces[p4] = pieces[p1];
@@ -356,7 +470,7 @@ class cube {
 
 };
 
-const cube solved[] = { //6 * 4 = 24 orientations to keep cube = 24 solved states, maybe generalize later
+constexpr cube solved[] = { //6 * 4 = 24 orientations to keep cube = 24 solved states, maybe generalize later
     { {0, 1, 2, 3, 4, 5, 6, 7}, {0, 0, 0, 0, 0, 0, 0, 0} }, //solved, white on top, green in front;
     { {3, 0, 1, 2, 5, 6, 7, 4}, {0, 0, 0, 0, 0, 0, 0, 0} }, //solved, W top, R front;
     { {2, 3, 0, 1, 6, 7, 4, 5}, {0, 0, 0, 0, 0, 0, 0, 0} }, //W top, B front;
@@ -383,6 +497,546 @@ const cube solved[] = { //6 * 4 = 24 orientations to keep cube = 24 solved state
     { {2, 5, 4, 3, 0, 7, 6, 1}, {1, 2, 1, 2, 1, 2, 1, 2} } //G top, O front;
 };
 
+constexpr int factorials[] = {1, 1, 2, 6, 24, 120, 720, 5040, 40320};
+constexpr int pow3[] = {1, 3, 9, 27, 81, 243, 729};
+
+constexpr int cube_hash(const cube &c) {
+    /* Hash is calculated as:
+     * L = Lehmer code of permutation of corners
+     *      there are 7 such corners, one is fixed (UBL)
+     *
+     * A = Amount of possible corner orientations for a given permutation of corners
+     *      Orientation of UBL is fixed
+     *      Orientation of DBL depends on rest of the corners
+     *      Each other corner has 3 orientations each
+     *      so A = 3^6 = 729
+     *
+     * D = Decimal equivalent of the orientation of corners expressed in ternary
+     *      there are 729 such cases, D lies between 0 and 728
+     *
+     *  Final Hash = LA + D
+     *
+     * This hash is 1:1 for all ~3.6 million nodes
+     *
+     * The pieces not used yet are kept as bits of a mask,
+     * so each Lehmer digit is just the number of unused pieces smaller than the current one (popcount)
+     * No allocations, and usable at compile time
+     */
+
+    unsigned unused = 0xFE; // pieces 1 to 7
+    int perm = 0;
+    int orie = 0;
+
+    for (int i = 1; i < 7; i++) {
+        unsigned bit = 1u << c.pieces[i];
+        perm += __builtin_popcount(unused & (bit - 1)) * factorials[7 - i]; // L
+        unused &= ~bit;
+        orie += c.orientations[i] * pow3[6 - i]; // D
+    }
+
+    return perm * 729 + orie; // A
+}
+
+constexpr array<array<uint8_t, 8>, 256> make_nth_bit() {
+    // nth_bit[mask][k] = position of the k-th lowest set bit of mask (k < popcount(mask))
+    array<array<uint8_t, 8>, 256> table{};
+    for (int mask = 0; mask < 256; mask++) {
+        for (int bit = 0, k = 0; bit < 8; bit++) {
+            if (mask >> bit & 1) table[mask][k++] = bit;
+        }
+    }
+    return table;
+}
+
+inline constexpr array<array<uint8_t, 8>, 256> nth_bit = make_nth_bit();
+
+constexpr cube unhash(int hash) {
+    // Generates a cube from the given hash
+    // Essentially the reverse of the hash function
+    // 1 to 1 correspondence so this is possible
+
+    cube c{};
+    int or_sum = 0;
+    int perm = hash / 729;
+    int orie = hash % 729;
+    unsigned unused = 0xFE;
+
+    c.pieces[0] = 0;
+    c.orientations[0] = 0;
+    for (int i = 1; i <= 6; i++) {
+        c.orientations[i] = orie / pow3[6 - i];
+        or_sum += c.orientations[i];
+        orie %= pow3[6 - i];
+
+        // the Lehmer digit picks the digit-th smallest unused piece (one 2 KB table lookup, no loop over the digit)
+        int digit = perm / factorials[7 - i];
+        perm %= factorials[7 - i];
+        c.pieces[i] = nth_bit[unused][digit];
+        unused &= ~(1u << c.pieces[i]);
+    }
+    c.orientations[7] = (3 - (or_sum % 3)) % 3;
+    c.pieces[7] = __builtin_ctz(unused);
+
+    return c;
+}
+
+constexpr cube compose(const cube &a, const cube &b) {
+    // the cube you get by doing b to a
+    // b is read as a position permutation + twists (b applied to a solved cube), which is how moves and rotations work
+    cube c{};
+    for (int i = 0; i < 8; i++) {
+        c.pieces[i] = a.pieces[b.pieces[i]];
+        c.orientations[i] = (a.orientations[b.pieces[i]] + b.orientations[i]) % 3;
+    }
+    return c;
+}
+
+static_assert(cube_hash(unhash(0)) == 0);
+static_assert(cube_hash(unhash(1234567)) == 1234567);
+static_assert(cube_hash(unhash(3674159)) == 3674159);
+
+inline bool hash_self_check() {
+    /*
+     * The whole state space: unhash(h) has to be a real cube with UBL solved
+     * (pieces a permutation with piece 0 in position 0, orientations summing to 0 mod 3)
+     * and cube_hash has to give h back, so unhash is 1:1 onto those cubes and cube_hash is its inverse
+     */
+    for (int h = 0; h < 3674160; h++) {
+        cube c = unhash(h);
+        unsigned seen = 0;
+        int twist = 0;
+        for (int i = 0; i < 8; i++) {
+            seen |= 1u << c.pieces[i];
+            twist += c.orientations[i];
+        }
+        if (seen != 0xFF || c.pieces[0] != 0 || c.orientations[0] != 0 || twist % 3 || cube_hash(c) != h) return false;
+    }
+    return true;
+}
+
+/*
+ * Packed cube
+ *
+ * The same state in 16 bytes: bytes 0 - 7 = pieces, 8 - 15 = orientations
+ * A move or rotation is a position permutation + twists (what it does to a solved cube, see compose),
+ * so applying one is a single byte shuffle that moves pieces and orientations together,
+ * then the twists are added and brought back under 3
+ *
+ * With SSSE3 (-mssse3 or -march=native) that is pshufb + add + min, otherwise a plain loop over the bytes
+ * The shuffle/twist tables are worked out at compile time from cube::apply_move and cube::apply_rotation
+ */
+
+struct alignas(16) packed_transform {
+    array<uint8_t, 16> shuffle; // byte i of the result comes from byte shuffle[i]
+    array<uint8_t, 16> twist;   // added to the orientation bytes afterwards
+};
+
+constexpr packed_transform make_packed_transform(const cube &b) {
+    packed_transform t{};
+    for (int i = 0; i < 8; i++) {
+        t.shuffle[i] = b.pieces[i];
+        t.shuffle[8 + i] = 8 + b.pieces[i];
+        t.twist[8 + i] = b.orientations[i];
+    }
+    return t;
+}
+
+constexpr array<packed_transform, 27> make_packed_transforms() {
+    // 0 - 17 = moves, 18 - 26 = rotations, both in the same order as cube::apply_move / cube::apply_rotation
+    array<packed_transform, 27> t{};
+    for (int m = 0; m < 18; m++) {
+        cube b = solved[0];
+        b.apply_move(m);
+        t[m] = make_packed_transform(b);
+    }
+    for (int r = 0; r < 9; r++) {
+        cube b = solved[0];
+        b.apply_rotation(r);
+        t[18 + r] = make_packed_transform(b);
+    }
+    return t;
+}
+
+inline constexpr array<packed_transform, 27> packed_transforms = make_packed_transforms();
+
+struct alignas(16) packed_cube {
+    array<uint8_t, 16> bytes;
+
+    constexpr packed_cube() : bytes{} {}
+
+    constexpr explicit packed_cube(const cube &c) : bytes{} {
+        for (int i = 0; i < 8; i++) {
+            bytes[i] = c.pieces[i];
+            bytes[8 + i] = c.orientations[i];
+        }
+    }
+
+    constexpr cube unpack() const {
+        cube c{};
+        for (int i = 0; i < 8; i++) {
+            c.pieces[i] = bytes[i];
+            c.orientations[i] = bytes[8 + i];
+        }
+        return c;
+    }
+
+    constexpr bool operator==(const packed_cube &rhs) const {
+        for (int i = 0; i < 16; i++) if (bytes[i] != rhs.bytes[i]) return false;
+        return true;
+    }
+
+    constexpr void apply_scalar(const packed_transform &t) {
+        // fallback (and the constexpr version), byte by byte
+        array<uint8_t, 16> old = bytes;
+        for (int i = 0; i < 8; i++) bytes[i] = old[t.shuffle[i]];
+        for (int i = 8; i < 16; i++) {
+            int b = old[t.shuffle[i]] + t.twist[i];
+            bytes[i] = b - 3 * (b >= 3);
+        }
+    }
+
+    void apply(const packed_transform &t) {
+#ifdef __SSSE3__
+        const __m128i three = _mm_set_epi8(3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0);
+        __m128i x = _mm_load_si128(reinterpret_cast<const __m128i *>(bytes.data()));
+        x = _mm_shuffle_epi8(x, _mm_load_si128(reinterpret_cast<const __m128i *>(t.shuffle.data())));
+        x = _mm_add_epi8(x, _mm_load_si128(reinterpret_cast<const __m128i *>(t.twist.data())));
+        x = _mm_min_epu8(x, _mm_sub_epi8(x, three)); // orientation 3 or 4 -> 0 or 1 (x - 3 wraps around below 3)
+        _mm_store_si128(reinterpret_cast<__m128i *>(bytes.data()), x);
+#else
+        apply_scalar(t);
+#endif
+    }
+
+    template <int move>
+    void apply_move() {
+        // move known at compile time, so the shuffle and twist are constants
+        static_assert(move >= 0 && move < 18);
+        apply(packed_transforms[move]);
+    }
+
+    void apply_move(int move) { apply(packed_transforms[move]); }
+    void apply_rotation(int rotation) { apply(packed_transforms[18 + rotation]); }
+};
+
+constexpr bool packed_matches_cube(const cube &start) {
+    // every move and rotation on the packed form gives the same cube as cube::apply_move / apply_rotation
+    for (int m = 0; m < 27; m++) {
+        cube c = start;
+        if (m < 18) c.apply_move(m);
+        else c.apply_rotation(m - 18);
+        packed_cube p(start);
+        p.apply_scalar(packed_transforms[m]);
+        if (!(p == packed_cube(c))) return false;
+    }
+    return true;
+}
+
+static_assert(packed_matches_cube(unhash(1234567)));
+static_assert(packed_matches_cube(unhash(3000001)));
+
+inline bool packed_cube_self_check() {
+    // same check at run time, for the SIMD path (the scalar path is checked at compile time above)
+    for (int h = 0; h < 3674160; h += 7919) {
+        cube start = unhash(h);
+        for (int m = 0; m < 27; m++) {
+            cube c = start;
+            packed_cube p(start);
+            if (m < 18) {
+                c.apply_move(m);
+                p.apply_move(m);
+            }
+            else {
+                c.apply_rotation(m - 18);
+                p.apply_rotation(m - 18);
+            }
+            if (!(p == packed_cube(c))) return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Orientation tables
+ *
+ * Cubes are solved turned to white top green front, find_orientation() says which of the 24 ways round a cube is
+ * wca_rotations[o] = the rotations (cube::apply_rotation, -1 = none) that turn orientation o to white top green front
+ * wca_transforms[o] = those rotations as a single transform, so normalizing is one shuffle whatever o is
+ * wca_move_maps[o][m] = solving move m (0 - 8, R F D only) seen from orientation o, as a cube::apply_move index
+ *      i.e. rotate, do m, rotate back (what str_rotate does to the text, see orientation_tables_self_check)
+ */
+
+constexpr array<array<int8_t, 2>, 24> wca_rotations = {{
+    {-1, -1}, {0, 8}, {3, 6}, {8, -1}, {3, 7}, {2, -1}, {7, -1}, {2, 6},
+    {2, 5}, {6, -1}, {5, -1}, {2, 4}, {4, -1}, {0, 6}, {0, 5}, {1, 6},
+    {5, 7}, {2, 7}, {1, -1}, {2, 8}, {3, 8}, {4, 6}, {3, -1}, {0, -1}
+}};
+
+constexpr int inverse_rotation(int rotation) {
+    // z <-> z', x <-> x', y <-> y', half turns are their own inverse
+    return 3 * (rotation / 3) + 2 - rotation % 3;
+}
+
+constexpr void rotate_to_wca_slow(cube &c, int orientation) {
+    for (int r : wca_rotations[orientation]) if (r >= 0) c.apply_rotation(r);
+}
+
+constexpr void rotate_from_wca_slow(cube &c, int orientation) {
+    for (int i = 1; i >= 0; i--) {
+        if (wca_rotations[orientation][i] >= 0) c.apply_rotation(inverse_rotation(wca_rotations[orientation][i]));
+    }
+}
+
+constexpr array<packed_transform, 24> make_wca_transforms() {
+    array<packed_transform, 24> t{};
+    for (int o = 0; o < 24; o++) {
+        cube b = solved[0];
+        rotate_to_wca_slow(b, o);
+        t[o] = make_packed_transform(b);
+    }
+    return t;
+}
+
+inline constexpr array<packed_transform, 24> wca_transforms = make_wca_transforms();
+
+constexpr array<array<uint8_t, 9>, 24> make_wca_move_maps() {
+    array<array<uint8_t, 9>, 24> maps{};
+    for (int o = 0; o < 24; o++) {
+        for (int m = 0; m < 9; m++) {
+            cube b = solved[0];
+            rotate_to_wca_slow(b, o);
+            b.apply_move(m);
+            rotate_from_wca_slow(b, o);
+            for (int real = 0; real < 18; real++) {
+                cube r = solved[0];
+                r.apply_move(real);
+                if (packed_cube(r) == packed_cube(b)) maps[o][m] = real;
+            }
+        }
+    }
+    return maps;
+}
+
+inline constexpr array<array<uint8_t, 9>, 24> wca_move_maps = make_wca_move_maps();
+
+inline void cube::rotate_to_wca() {
+    packed_cube p(*this);
+    p.apply(wca_transforms[find_orientation()]);
+    for (int i = 0; i < 8; i++) {
+        pieces[i] = p.bytes[i];
+        orientations[i] = p.bytes[8 + i];
+    }
+}
+
+constexpr bool wca_tables_match(cube c) {
+    // every orientation of c is numbered as expected and its transform turns it back into c
+    for (int o = 0; o < 24; o++) {
+        cube turned = c;
+        rotate_from_wca_slow(turned, o);
+        if (turned.find_orientation() != o) return false;
+        packed_cube p(turned);
+        p.apply_scalar(wca_transforms[o]);
+        if (!(p == packed_cube(c))) return false;
+    }
+    return true;
+}
+
+static_assert(wca_tables_match(solved[0]));
+static_assert(wca_tables_match(unhash(1234567)));
+static_assert(wca_move_maps[22][6] == 6 && wca_move_maps[22][0] == 15 && wca_move_maps[22][3] == 0); // x: R, U, F
+
+/*
+ * Batch hashing
+ *
+ * hash_batch / unhash_batch do the same as cube_hash / unhash over whole arrays
+ * With AVX2 (checked at run time, so one binary runs everywhere) 8 cubes go through at once:
+ * the cubes are transposed into one register per position (lane k = cube k, structure of arrays),
+ * every Lehmer digit is a count of compares and the ternary digits are a multiply-add
+ * Anything left over (or a CPU without AVX2) goes through the scalar functions
+ * (the small loops are unrolled by pragma so all of it stays in registers, -O2 won't do that by itself)
+ *
+ * The Lehmer digit of position i is counted as the number of later pieces smaller than pieces[i],
+ * the same as cube_hash for every cube with UBL in place (which is every cube that gets hashed)
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+static_assert(sizeof(cube) == 20 && offsetof(cube, orientations) == 8, "the loads below read pieces + orientations as 16 bytes");
+
+__attribute__((target("avx2")))
+inline __m256i times_small(__m256i v, int m) {
+    // v * m for a constant m < 2^12 as shifts and adds (mullo is 10 cycles), once the caller is unrolled
+    __m256i r = _mm256_setzero_si256();
+    #pragma GCC unroll 12
+    for (int b = 0; b < 12; b++) {
+        if ((m >> b) & 1) r = _mm256_add_epi32(r, _mm256_slli_epi32(v, b));
+    }
+    return r;
+}
+
+__attribute__((target("avx2")))
+inline __m256i div_small(__m256i v, int d) {
+    // v / d for 0 <= v < 2^24, through float then fixed up by one if the rounding went the wrong way
+    __m256i q = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f / d)));
+    __m256i r = _mm256_sub_epi32(v, times_small(q, d));
+    q = _mm256_sub_epi32(q, _mm256_cmpgt_epi32(r, _mm256_set1_epi32(d - 1)));
+    return _mm256_add_epi32(q, _mm256_cmpgt_epi32(_mm256_setzero_si256(), r));
+}
+
+__attribute__((target("avx2")))
+inline __m256i load_pair(const cube *lo, const cube *hi) {
+    // the 16 bytes of pieces + orientations of two cubes, one per 128 bit half
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lo))),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi)), 1);
+}
+
+__attribute__((target("avx2")))
+inline void transpose_8x4(__m256i a0, __m256i a1, __m256i a2, __m256i a3, __m256i *w) {
+    /*
+     * a0 - a3 hold cubes (0, 4), (1, 5), (2, 6), (3, 7), as 4 words each
+     * w[i] ends up with word i of cubes 0 - 7 in order (and applying it again undoes it)
+     */
+    __m256i t0 = _mm256_unpacklo_epi32(a0, a1);
+    __m256i t1 = _mm256_unpackhi_epi32(a0, a1);
+    __m256i t2 = _mm256_unpacklo_epi32(a2, a3);
+    __m256i t3 = _mm256_unpackhi_epi32(a2, a3);
+    w[0] = _mm256_unpacklo_epi64(t0, t2);
+    w[1] = _mm256_unpackhi_epi64(t0, t2);
+    w[2] = _mm256_unpacklo_epi64(t1, t3);
+    w[3] = _mm256_unpackhi_epi64(t1, t3);
+}
+
+__attribute__((target("avx2")))
+inline void hash_batch_avx2(const cube *cubes, size_t n, int *hashes) {
+    const __m256i byte = _mm256_set1_epi32(0xFF);
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256i w[4];
+        transpose_8x4(load_pair(cubes + k, cubes + k + 4), load_pair(cubes + k + 1, cubes + k + 5),
+                      load_pair(cubes + k + 2, cubes + k + 6), load_pair(cubes + k + 3, cubes + k + 7), w);
+        // w[0], w[1] = pieces[0 - 3], pieces[4 - 7], w[2], w[3] = same for orientations
+        __m256i p[8], o[8];
+        #pragma GCC unroll 8
+        for (int b = 0; b < 4; b++) {
+            #pragma GCC unroll 8
+            for (int h = 0; h < 2; h++) {
+                p[4 * h + b] = _mm256_and_si256(_mm256_srli_epi32(w[h], 8 * b), byte);
+                o[4 * h + b] = _mm256_and_si256(_mm256_srli_epi32(w[2 + h], 8 * b), byte);
+            }
+        }
+
+        // both numbers built Horner style (perm = (((d1 * 6 + d2) * 5 + d3) * 4 ...), so only small multiplies
+        __m256i perm = _mm256_setzero_si256();
+        __m256i orie = _mm256_setzero_si256();
+        #pragma GCC unroll 8
+        for (int i = 1; i < 7; i++) {
+            __m256i digit = _mm256_setzero_si256();
+            #pragma GCC unroll 8
+            for (int j = i + 1; j < 8; j++) digit = _mm256_sub_epi32(digit, _mm256_cmpgt_epi32(p[i], p[j]));
+            perm = _mm256_add_epi32(times_small(perm, 8 - i), digit);
+            orie = _mm256_add_epi32(times_small(orie, 3), o[i]);
+        }
+        __m256i hash = _mm256_add_epi32(times_small(perm, 729), orie);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(hashes + k), hash);
+    }
+    for (; k < n; k++) hashes[k] = cube_hash(cubes[k]);
+}
+
+__attribute__((target("avx2")))
+inline void unhash_batch_avx2(const int *hashes, size_t n, cube *cubes) {
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(hashes + k));
+        __m256i perm = div_small(h, 729);
+        __m256i orie = _mm256_sub_epi32(h, times_small(perm, 729));
+
+        __m256i p[8], o[8];
+        p[0] = o[0] = p[7] = _mm256_setzero_si256();
+        __m256i or_sum = _mm256_setzero_si256();
+        #pragma GCC unroll 8
+        for (int i = 1; i < 7; i++) {
+            // every digit straight from the whole number (x / base % radix), so the divisions don't wait on each other
+            __m256i q = div_small(orie, pow3[6 - i]);
+            o[i] = _mm256_sub_epi32(q, times_small(div_small(q, 3), 3));
+            or_sum = _mm256_add_epi32(or_sum, o[i]);
+            q = div_small(perm, factorials[7 - i]);
+            p[i] = _mm256_sub_epi32(q, times_small(div_small(q, 8 - i), 8 - i));
+        }
+        // last orientation = (3 - sum % 3) % 3, with sum % 3 = sum - 3 * (sum * 11 >> 5) for sum <= 12
+        __m256i rem = _mm256_sub_epi32(or_sum, times_small(_mm256_srli_epi32(times_small(or_sum, 11), 5), 3));
+        o[7] = _mm256_and_si256(_mm256_sub_epi32(_mm256_set1_epi32(3), rem), _mm256_cmpgt_epi32(rem, _mm256_setzero_si256()));
+
+        // Lehmer digits -> pieces, from the back: every later piece at or above the current one moves up by one
+        #pragma GCC unroll 8
+        for (int i = 6; i >= 1; i--) {
+            #pragma GCC unroll 8
+            for (int j = i + 1; j < 8; j++) p[j] = _mm256_add_epi32(p[j], _mm256_add_epi32(one, _mm256_cmpgt_epi32(p[i], p[j])));
+        }
+        #pragma GCC unroll 8
+        for (int i = 1; i < 8; i++) p[i] = _mm256_add_epi32(p[i], one);
+
+        // back to one 32 bit word per 4 bytes of the cube, then transposed back to cube order
+        __m256i w[4];
+        #pragma GCC unroll 8
+        for (int h = 0; h < 2; h++) {
+            __m256i pw = p[4 * h], ow = o[4 * h];
+            #pragma GCC unroll 8
+            for (int b = 1; b < 4; b++) {
+                pw = _mm256_or_si256(pw, _mm256_slli_epi32(p[4 * h + b], 8 * b));
+                ow = _mm256_or_si256(ow, _mm256_slli_epi32(o[4 * h + b], 8 * b));
+            }
+            w[h] = pw;
+            w[2 + h] = ow;
+        }
+        __m256i c[4];
+        transpose_8x4(w[0], w[1], w[2], w[3], c);
+        #pragma GCC unroll 8
+        for (int l = 0; l < 4; l++) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(cubes + k + l), _mm256_castsi256_si128(c[l]));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(cubes + k + 4 + l), _mm256_extracti128_si256(c[l], 1));
+            cubes[k + l].cur_orientation = cubes[k + 4 + l].cur_orientation = 0;
+        }
+    }
+    for (; k < n; k++) cubes[k] = unhash(hashes[k]);
+}
+
+inline bool has_avx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif
+
+inline void hash_batch(const cube *cubes, size_t n, int *hashes) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (has_avx2()) return hash_batch_avx2(cubes, n, hashes);
+#endif
+    for (size_t k = 0; k < n; k++) hashes[k] = cube_hash(cubes[k]);
+}
+
+inline void unhash_batch(const int *hashes, size_t n, cube *cubes) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (has_avx2()) return unhash_batch_avx2(hashes, n, cubes);
+#endif
+    for (size_t k = 0; k < n; k++) cubes[k] = unhash(hashes[k]);
+}
+
+inline bool batch_hash_self_check() {
+    // whole state space through both batch functions, against the scalar ones
+    const int n = 3674160;
+    vector<int> hashes(n), rehashed(n);
+    vector<cube> cubes(n);
+    for (int h = 0; h < n; h++) hashes[h] = h;
+    unhash_batch(hashes.data(), n, cubes.data());
+    hash_batch(cubes.data(), n, rehashed.data());
+    for (int h = 0; h < n; h++) {
+        cube c = unhash(h);
+        if (rehashed[h] != h || cube_hash(cubes[h]) != h || cubes[h].pieces != c.pieces || cubes[h].orientations != c.orientations) return false;
+    }
+    return true;
+}
+
 inline void replaceAll(string& str, const string& from, const string& to) {
     // function replaces all instances of a substring to another
     // code shamelessly stolen from stackoverflow
@@ -443,13 +1097,75 @@ inline void str_rotate(string &sol, int orient) {
     else if (orient == 23) change("U", "F", "R");
 }
 
-inline cube random_cube(void) {
+inline bool orientation_tables_self_check() {
+    // wca_move_maps against the text replacement it replaced, every move in every orientation
+    const string faces = "FDRLBU"; // in cube::apply_move order
+    const char *suffixes[] = {"", "2", "'"};
+    for (int o = 0; o < 24; o++) {
+        for (int m = 0; m < 9; m++) {
+            string text = string(1, faces[m / 3]) + suffixes[m % 3];
+            str_rotate(text, o);
+            int real = wca_move_maps[o][m];
+            if (text != string(1, faces[real / 3]) + suffixes[real % 3]) return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Fast seedable RNG (xoshiro256**), for anything that draws a lot of random states
+ * it's a standard UniformRandomBitGenerator, so it also works with shuffle and the <random> distributions
+ * The seed is spread over the state with splitmix64, so seeds 0, 1, 2... give unrelated streams
+ */
+
+constexpr uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+struct xoshiro256 {
+    using result_type = uint64_t;
+    uint64_t s[4];
+
+    explicit xoshiro256(uint64_t seed = 0) {
+        for (int i = 0; i < 4; i++) s[i] = seed = splitmix64(seed);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t operator()() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    uint32_t below(uint32_t n) {
+        // uniform in [0, n) without the modulo bias (Lemire's multiply and reject, almost never loops)
+        uint64_t m = (uint64_t) (uint32_t) ((*this)() >> 32) * n;
+        if ((uint32_t) m < n) {
+            uint32_t threshold = -n % n;
+            while ((uint32_t) m < threshold) m = (uint64_t) (uint32_t) ((*this)() >> 32) * n;
+        }
+        return m >> 32;
+    }
+};
+
+template <typename rng_t>
+cube random_cube(rng_t &rng) {
     // generates a random cube by randomly permuting the 8 cubies, and randomly orienting 7
     // The orientation of the last cubie depends on the orientation of the other 7
-
-    random_device rd;
-    linear_congruential_engine<std::uint_fast32_t, 48271, 0, 2147483647> rng;
-    rng.seed(rd());
+    // takes the RNG so a seeded one gives the same cubes every run
 
     cube c;
     c.pieces = {0, 1, 2, 3, 4, 5, 6, 7};
@@ -466,4 +1182,11 @@ inline cube random_cube(void) {
     return c;
 }
 
+inline cube random_cube(void) {
+    // same as above with an RNG per thread, seeded once from random_device
+
+    thread_local xoshiro256 rng(random_device{}() * 0x100000000ull + random_device{}());
+    return random_cube(rng);
+}
+
 #endif
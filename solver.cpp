@@ -1,271 +1,1292 @@
-#include "cube.hpp"
+#include "solver.hpp"
 #include <algorithm>
+#include <arpa/inet.h>
 #include <array>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <queue>
 #include <random>
-#include <set>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 using namespace std;
 // Alphabetically ordered header files :D
 
-const int states = 3674160;
-// Number of states
+string metrics_format; // "json" or "prometheus" once --metrics turned them on
+atomic<bool> metrics_dump_requested{false};
+string table_dir = "."; // --tables, for every engine the modes below load
 
-int cube_hash(cube &c) {
-    /* Hash is calculated as:
-     * L = Lehmer code of permutation of corners
-     *      there are 7 such corners, one is fixed (UBL)
-     *
-     * A = Amount of possible corner orientations for a given permutation of corners
-     *      Orientation of UBL is fixed
-     *      Orientation of DBL depends on rest of the corners
-     *      Each other corner has 3 orientations each
-     *      so A = 3^6 = 729
-     *
-     * D = Decimal equivalent of the orientation of corners expressed in ternary
-     *      there are 729 such cases, D lies between 0 and 728
-     *
-     *  Final Hash = LA + D
-     *
-     * This hash is 1:1 for all ~3.6 million nodes
-     *
+void load_or_exit(solver &engine, int threads) {
+    // every mode needs its table, so one that can't be loaded or built ends the run
+    string error;
+    engine.table_dir = table_dir;
+    if (engine.load(threads, error)) return;
+    cerr << error << "\n";
+    exit(1);
+}
+
+void dump_metrics() {
+    // snapshot to stderr, so it never mixes with results on stdout
+    string text = metrics_format == "json" ? solver_metrics.json() : solver_metrics.prometheus();
+    fwrite(text.data(), 1, text.size(), stderr);
+    fflush(stderr);
+}
+
+void request_metrics_dump(int) {
+    // SIGUSR1 handler for batch and interactive mode, which check the flag (the daemon uses sigwait instead)
+    // batch mode between blocks, interactive mode as soon as the signal interrupts the wait for input
+    metrics_dump_requested = true;
+}
+
+void bfs_scaling_report(int max_threads) {
+    // times both layouts for 1 to max_threads threads and checks them against the serial builders
+
+    vector<uint8_t> graph_serial((uint64_t) states * sizeof(graph_node)), table_serial(depth_table::bytes);
+    auto time_ms = [](auto fn) {
+        auto start_time = chrono::high_resolution_clock::now();
+        fn();
+        auto end_time = chrono::high_resolution_clock::now();
+        return chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count();
+    };
+
+    get_move_tables();
+    long long graph_base = time_ms([&]() { make_graph(graph_serial); });
+    long long table_base = time_ms([&]() { make_table(table_serial); });
+
+    vector<uint8_t> graph_par(graph_serial.size()), table_par(table_serial.size());
+    cout << "threads\tgraph_ms\tgraph_speedup\ttable_ms\ttable_speedup\tidentical\n";
+    cout << "serial\t" << graph_base << "\t1.00\t" << table_base << "\t1.00\tyes\n";
+    for (int t = 1; t <= max_threads; t++) {
+        long long graph_ms = time_ms([&]() { make_graph_parallel(graph_par, t); });
+        long long table_ms = time_ms([&]() { make_table_parallel(table_par, t); });
+        bool identical = graph_par == graph_serial && table_par == table_serial;
+        printf("%d\t%lld\t%.2f\t%lld\t%.2f\t%s\n", t,
+               graph_ms, (double) graph_base / max(1LL, graph_ms),
+               table_ms, (double) table_base / max(1LL, table_ms),
+               identical ? "yes" : "NO");
+    }
+}
+
+void engine_benchmark(int count, int threads) {
+    /*
+     * Compares the engines on a fixed (seeded) set of random states
+     * time to first answer = everything from startup to the first solution, including building/mapping tables
+     * steady state = average time per solve after that, p99 = from a second pass timing every solve on its own
+     * memory = bytes of tables the engine looks at while solving
+     * also checks every engine gives solutions of the same length as the depth table
+     * mitm runs once per k, which gives its memory/latency curve
      */
 
-    set<int> os = {1, 2, 3, 4, 5, 6, 7};
-    vector<int> factorials = {1, 1, 2, 6, 24, 120, 720, 5040, 40320};
-    vector<int> pow3 = {1, 3, 9, 27, 81, 243, 729};
-    vector<int> factoradic;
-    int final_hash = 0;
-
-    for (int i = 1; i < 7; i++) {
-        int idx = 0;
-        for (auto it: os) {
-            if (it == c.pieces[i]) {
-                factoradic.push_back(idx);
-                os.erase(it);
-            }
-            idx++;
+    mt19937 gen(12345);
+    uniform_int_distribution<int> pick(0, states - 1);
+    vector<int> hashes(count);
+    for (int &h : hashes) h = pick(gen);
+
+    auto now = []() { return chrono::high_resolution_clock::now(); };
+    auto us = [](auto d) { return chrono::duration<double, micro>(d).count(); };
+
+    vector<pair<string, int>> engines = {{"depth", 0}, {"sym", 0}, {"ida", 0}};
+    for (int k = 3; k <= 8; k++) engines.push_back({"mitm", k});
+
+    vector<int> reference(count);
+    vector<double> times(count);
+    printf("engine\tmemory_bytes\tfirst_answer_us\tsteady_us_per_solve\tp99_us\tlength_mismatches\n");
+    for (const auto &[name, k] : engines) {
+        solver engine;
+        engine.name = name;
+        engine.mitm_depth = k;
+        move_buffer moves;
+
+        auto start_time = now();
+        load_or_exit(engine, threads);
+        engine.solve(hashes[0], moves.data());
+        double first = us(now() - start_time);
+
+        vector<int> lengths(count);
+        start_time = now();
+        for (int i = 0; i < count; i++) lengths[i] = engine.solve(hashes[i], moves.data());
+        double steady = us(now() - start_time) / count;
+        for (int i = 0; i < count; i++) {
+            auto solve_start = now();
+            engine.solve(hashes[i], moves.data());
+            times[i] = us(now() - solve_start);
         }
+        sort(times.begin(), times.end());
+
+        if (engine.name == "depth") reference = lengths;
+        int mismatches = 0;
+        for (int i = 0; i < count; i++) mismatches += lengths[i] != reference[i];
+        string label = k ? name + "/" + to_string(k) : name;
+        printf("%s\t%zu\t%.1f\t%.2f\t%.2f\t%d\n", label.c_str(), engine.memory(), first, steady,
+               times[count * 99 / 100], mismatches);
     }
+}
 
-    for (int i = 0; i < factoradic.size(); i++) final_hash += factoradic[i] * factorials[6 - i]; //L
+void interleave_benchmark(int count, int threads) {
+    /*
+     * solution() one state at a time against interleaved_solutions with 1 to 64 lanes, for the graph and the depth table
+     * Same seeded random states for everything, solved on one thread (per core throughput is the point)
+     * mismatches = states whose moves differ from the one at a time ones
+     */
 
-    final_hash *= 729; // A
+    mt19937 gen(4242);
+    uniform_int_distribution<int> pick(0, states - 1);
+    vector<int> hashes(count);
+    for (int &h : hashes) h = pick(gen);
+    vector<move_buffer> reference(count), moves(count);
+    vector<int> reference_lengths(count), lengths(count);
 
-    for (int i = 1; i < 7; i++) final_hash += c.orientations[i] * pow3[6 - i]; // D
+    printf("engine\tlanes\tns_per_solve\tsolves_per_sec\tspeedup\tmismatches\n");
+    for (const char *name : {"graph", "depth"}) {
+        solver engine;
+        engine.name = name;
+        load_or_exit(engine, threads);
 
-    return final_hash;
-}
+        auto start_time = chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; i++) reference_lengths[i] = engine.solve(hashes[i], reference[i].data());
+        double base = chrono::duration<double, nano>(chrono::high_resolution_clock::now() - start_time).count() / count;
+        printf("%s\tone_at_a_time\t%.1f\t%.0f\t1.00\t0\n", name, base, 1e9 / base);
 
-cube unhash(int hash) {
-    // Generates a cube from the given hash
-    // Essentially the reverse of the hash function
-    // 1 to 1 correspondence so this is possible
-
-
-    cube c;
-    int or_sum = 0;
-    int perm = hash / 729;
-    int orie = hash % 729;
-    vector<int> factoradic;
-    vector<int> factorials = {1, 1, 2, 6, 24, 120, 720, 5040, 40320};
-    vector<int> pow3 = {1, 3, 9, 27, 81, 243, 729};
-    set<int> os = {1, 2, 3, 4, 5, 6, 7};
-
-    c.orientations[0] = 0;
-    for (int i = 1; i <= 6; i++) {
-        c.orientations[i] = orie / pow3[6-i];
-        or_sum += c.orientations[i];
-        orie %= pow3[6-i];
-    }
-    c.orientations[7] = (3 - (or_sum%3)) % 3;
-
-    c.pieces[0] = 0;    
-    for (int i = 1; i <= 6; i++) {
-        factoradic.push_back(perm / factorials[7-i]);
-        perm %= factorials[7-i];
-    }
-
-    for (int i = 1; i < 7; i++) {
-        int idx = 0;
-        for (auto it: os) {
-            if (idx == factoradic[i-1]) {
-                c.pieces[i] = it;
-                os.erase(it);
+        for (int lanes = 1; lanes <= max_lanes; lanes *= 2) {
+            start_time = chrono::high_resolution_clock::now();
+            if (engine.name == "graph") {
+                interleaved_solutions(graph_walker{engine.graph.load()}, hashes.data(), count, moves.data(), lengths.data(), lanes);
+            }
+            else interleaved_solutions(depth_walker{engine.table}, hashes.data(), count, moves.data(), lengths.data(), lanes);
+            double ns = chrono::duration<double, nano>(chrono::high_resolution_clock::now() - start_time).count() / count;
+            int mismatches = 0;
+            for (int i = 0; i < count; i++) {
+                mismatches += lengths[i] != reference_lengths[i] ||
+                              !equal(moves[i].begin(), moves[i].begin() + lengths[i], reference[i].begin());
             }
-            idx++;
+            printf("%s\t%d\t%.1f\t%.0f\t%.2f\t%d\n", name, lanes, ns, 1e9 / ns, base / ns, mismatches);
         }
     }
-    c.pieces[7] = *os.begin();
-
-    return c; 
 }
 
-void make_graph(vector<pair<int, array<int, 9>>> &graph) {
+void batch_solve(const solver &engine, istream &in, const mapped_file *file, int threads) {
     /*
-     *  Graph is a vector of pairs
-     *  First element of pair -> depth from solved state
-     *  Second element of pair -> adjacency list
-     *  Adjacency list contains list of hashes of all cubes one turn away from the current cube state
-     *  Index of vector = hash of current cube state
-     *
-     *  initial depth = 20
-     *  initial adj list = {-1 x9}
-     *
-     *
-     */
-
-    vector<int> compliment = {2, 1, 0, 5, 4, 3, 8, 7, 6};
-    /* Stores the move compliment of a given move, from the cube header file
-     *
-     * for eg. move 0 = D, move 2 = D'
-     * if state 1 becomes state 2 upon performing D, then state 2 becomes 1 upon performing D'
-     * i.e compliment of D is D'
-     * => compliment of 0 is 2
-     * which is what this vector is for
-     * helps us fill the graph quicker
+     * Non-interactive mode: one scramble per line in, "scramble<TAB>solution" per line out, in input order
+     * (lines that don't parse get "error at OFFSET: reason" instead of a solution)
      *
+     * Lines are read in blocks, each block is split across the threads (the engine is read-only so they all share it),
+     * then the block is written out in order before the next one is read
+     * Each chunk of lines is solved together (solver::solve_scrambles), so the table misses overlap
+     * With a file the lines are views straight into the mapping, stdin is read line by line
+     * Throughput goes to stderr so stdout only has results
      */
 
+    const int block_size = 1 << 16;
+    const int lines_per_chunk = 256;
+    vector<string_view> lines;
+    vector<string> storage, results;
+    storage.reserve(block_size); // never reallocates, so the views into it stay valid
+    string_view text = file ? file->view() : string_view();
+    size_t pos = 0;
+    long long total = 0;
     auto start_time = chrono::high_resolution_clock::now();
-    if (!filesystem::exists("graph.bin")) {
-        ofstream graph_file("graph.bin", ios::binary);
-        graph[0].first = 0;
-        int ctr = 0;
-        queue<int> next;
-        next.push(0);
-        while (!next.empty()) {
-            int cur = next.front();
-            next.pop();
-            if (ctr % 100000 == 0) cout << ctr << ":" << endl;
-            for (int j = 0; j < 9; j++) {
-                if(graph[cur].second[j] == -1) {
-                    cube c = unhash(cur);
-                    c.apply_move(j);
-                    int adj = cube_hash(c);
-                    graph[cur].second[j] = adj;
-
-                    if(graph[adj].first == 20) {
-                        graph[adj].first = graph[cur].first + 1;
-                        next.push(adj);
-                    }
 
-                    graph[adj].second[compliment[j]] = cur;
+    auto next_line = [&](string_view &line) {
+        if (file) {
+            if (pos >= text.size()) return false;
+            size_t end = text.find('\n', pos);
+            if (end == string_view::npos) end = text.size();
+            line = text.substr(pos, end - pos);
+            pos = end + 1;
+        }
+        else {
+            storage.emplace_back();
+            if (!getline(in, storage.back())) return false;
+            line = storage.back();
+        }
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        return true;
+    };
+
+    while (true) {
+        lines.clear();
+        storage.clear();
+        string_view line;
+        while ((int) lines.size() < block_size && next_line(line)) lines.push_back(line);
+        if (lines.empty()) break;
+
+        int n = lines.size();
+        results.assign(n, "");
+        parallel_for(threads, (n + lines_per_chunk - 1) / lines_per_chunk, [&](int chunk) {
+            int begin = chunk * lines_per_chunk;
+            int end = min(n, begin + lines_per_chunk);
+            thread_local vector<string> solutions(lines_per_chunk);
+            engine.solve_scrambles(&lines[begin], end - begin, solutions.data());
+            for (int i = begin; i < end; i++) {
+                results[i].append(lines[i]).append(1, '\t').append(solutions[i - begin]).append(1, '\n');
+            }
+        });
+
+        for (const string &r : results) fwrite(r.data(), 1, r.size(), stdout);
+        if (metrics_dump_requested.exchange(false)) dump_metrics();
+        total += n;
+    }
+    fflush(stdout);
+
+    auto end_time = chrono::high_resolution_clock::now();
+    double seconds = chrono::duration<double>(end_time - start_time).count();
+    fprintf(stderr, "Solved %lld scrambles in %.3f seconds (%.0f solves/sec, %d threads)\n",
+            total, seconds, total / max(seconds, 1e-9), threads);
+}
+
+/*
+ * Daemon mode
+ *
+ * The engine is loaded once and requests come in over a socket:
+ *      ENDPOINT = a number => TCP on 127.0.0.1:ENDPOINT
+ *      anything else => path of a Unix domain socket
+ *
+ * Protocol is one line per request (a scramble) and one line per response (its solution), in order
+ * Clients can pipeline as many requests as they like before reading responses,
+ * but a connection stops being read while more than max_pending bytes of responses wait to be sent
+ * (and is dropped if it sends a line longer than max_request), so a client that never reads can't grow the buffers
+ * A client that shuts down its write side still gets every response before the connection is closed
+ * The request "health" gets "ok ..." back, with the result of the startup --verify if it was run
+ *
+ * Every worker thread runs its own epoll loop over the shared listening socket
+ * and keeps the connections it accepted, so there's no locking anywhere
+ */
+
+string health_status = "ok (tables not verified)"; // answer to "health", set before the workers start
+
+bool is_tcp_endpoint(const string &endpoint) {
+    return !endpoint.empty() && all_of(endpoint.begin(), endpoint.end(), [](char ch) { return isdigit(ch); });
+}
+
+int open_socket(const string &endpoint, bool listening) {
+    // returns a listening (non-blocking) or connected (blocking) socket for endpoint, -1 on failure
+
+    int fd;
+    int rc;
+    if (is_tcp_endpoint(endpoint)) {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(endpoint.c_str()));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | (listening ? SOCK_NONBLOCK : 0), 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (listening) rc = ::bind(fd, (sockaddr *) &addr, sizeof(addr));
+        else rc = connect(fd, (sockaddr *) &addr, sizeof(addr));
+    }
+    else {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (endpoint.size() >= sizeof(addr.sun_path)) return -1;
+        strcpy(addr.sun_path, endpoint.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | (listening ? SOCK_NONBLOCK : 0), 0);
+        if (fd < 0) return -1;
+        if (listening) {
+            // a socket left over from a previous run is replaced, anything else at that path is left alone
+            struct stat st;
+            if (lstat(endpoint.c_str(), &st) == 0) {
+                if (!S_ISSOCK(st.st_mode)) {
+                    ::close(fd);
+                    errno = EEXIST;
+                    return -1;
                 }
+                unlink(endpoint.c_str());
             }
-            ctr++;
+            rc = ::bind(fd, (sockaddr *) &addr, sizeof(addr));
         }
+        else rc = connect(fd, (sockaddr *) &addr, sizeof(addr));
+    }
+
+    if (rc == 0 && listening) rc = listen(fd, SOMAXCONN);
+    if (rc != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+const size_t max_pending = 1 << 20;
+// bytes of unsent responses before a connection stops being read
+const size_t max_request = 1 << 16;
+// longest request line
+
+struct connection {
+    string in;
+    string out;
+    size_t out_pos = 0;
+    bool eof = false; // client shut down its write side, close once out is sent
+};
+
+void serve_loop(const solver &engine, int listener) {
+    int ep = epoll_create1(0);
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.fd = listener;
+    epoll_ctl(ep, EPOLL_CTL_ADD, listener, &ev);
+
+    unordered_map<int, connection> conns;
+    array<epoll_event, 64> events;
+    char buf[65536];
+
+    auto close_conn = [&](int fd) {
+        epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        conns.erase(fd);
+    };
+
+    while (true) {
+        int n = epoll_wait(ep, events.data(), events.size(), -1);
+        for (int e = 0; e < n; e++) {
+            int fd = events[e].data.fd;
+
+            if (fd == listener) {
+                int client;
+                while ((client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                    int one = 1;
+                    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on unix sockets
+                    epoll_event cev = {};
+                    cev.events = EPOLLIN;
+                    cev.data.fd = client;
+                    epoll_ctl(ep, EPOLL_CTL_ADD, client, &cev);
+                    conns[client];
+                }
+                continue;
+            }
+
+            connection &c = conns[fd];
+            bool closed = events[e].events & (EPOLLERR | EPOLLHUP);
 
+            if ((events[e].events & EPOLLIN) && !c.eof) {
+                while (c.out.size() - c.out_pos < max_pending) {
+                    ssize_t got = read(fd, buf, sizeof(buf));
+                    if (got == 0) c.eof = true;
+                    else if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK) closed = true;
+                    if (got <= 0) break;
+                    c.in.append(buf, got);
+
+                    // answer every complete line, in order
+                    size_t start = 0, end;
+                    while ((end = c.in.find('\n', start)) != string::npos) {
+                        string_view scramble(c.in.data() + start, end - start);
+                        if (!scramble.empty() && scramble.back() == '\r') scramble.remove_suffix(1);
+                        if (scramble == "health") c.out += health_status;
+                        else c.out += engine.solve_scramble(scramble);
+                        c.out += '\n';
+                        start = end + 1;
+                    }
+                    c.in.erase(0, start);
+                    if (c.in.size() > max_request) {
+                        closed = true;
+                        break;
+                    }
+                }
+            }
 
-        for (int i = 0; i < states; i++) {
-            graph_file.write(reinterpret_cast<const char *>(&graph[i].first), sizeof(int));
-            for (int j = 0; j < 9; j++) {
-                graph_file.write(reinterpret_cast<const char *>(&graph[i].second[j]), sizeof(int));
+            while (c.out_pos < c.out.size()) {
+                ssize_t sent = send(fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos, MSG_NOSIGNAL);
+                if (sent <= 0) {
+                    if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) closed = true;
+                    break;
+                }
+                c.out_pos += sent;
+            }
+            if (c.out_pos == c.out.size()) {
+                c.out.clear();
+                c.out_pos = 0;
+            }
+            else if (c.out_pos > c.out.size() / 2) {
+                c.out.erase(0, c.out_pos);
+                c.out_pos = 0;
             }
 
+            if (closed || (c.eof && c.out.empty())) {
+                close_conn(fd);
+                continue;
+            }
+            // only ask for EPOLLIN while there is room for more responses, and EPOLLOUT while there are some to send
+            uint32_t wanted = 0;
+            if (!c.eof && c.out.size() - c.out_pos < max_pending) wanted |= EPOLLIN;
+            if (!c.out.empty()) wanted |= EPOLLOUT;
+            epoll_event cev = {};
+            cev.events = wanted;
+            cev.data.fd = fd;
+            epoll_ctl(ep, EPOLL_CTL_MOD, fd, &cev);
         }
     }
+}
 
-    else {
-        ifstream graph_file("graph.bin", ios::binary);
-        for (int i = 0; i < states; i++) {
-            graph_file.read(reinterpret_cast<char *>(&(graph[i].first)), sizeof(int));
+int serve(const solver &engine, const string &endpoint, int threads) {
+    signal(SIGPIPE, SIG_IGN);
+    int listener = open_socket(endpoint, true);
+    if (listener < 0) {
+        cerr << "could not listen on " << endpoint << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    cout << "Serving on " << (is_tcp_endpoint(endpoint) ? "127.0.0.1:" : "") << endpoint
+         << " with " << threads << " threads" << endl;
 
-            for (int j = 0; j < 9; j++) {
-                graph_file.read(reinterpret_cast<char *>(&(graph[i].second[j])), sizeof(int));
+    // with metrics on, SIGUSR1 is blocked in the workers (they inherit the mask) and waited for here instead
+    sigset_t usr1;
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    if (!metrics_format.empty()) pthread_sigmask(SIG_BLOCK, &usr1, nullptr);
+
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++) pool.emplace_back(serve_loop, cref(engine), listener);
+    int sig;
+    while (!metrics_format.empty() && sigwait(&usr1, &sig) == 0) dump_metrics();
+    for (auto &t : pool) t.join();
+    return 0;
+}
+
+string random_scramble(mt19937 &gen, int length) {
+    // random face turns, no two in a row on the same face
+    static const char faces[] = "RUFLDB";
+    static const char *suffixes[] = {"", "'", "2"};
+    string scramble;
+    int last = -1;
+    for (int i = 0; i < length; i++) {
+        int face;
+        do face = gen() % 6; while (face == last);
+        last = face;
+        if (i) scramble += ' ';
+        scramble += faces[face];
+        scramble += suffixes[gen() % 3];
+    }
+    return scramble;
+}
+
+int load_generator(const string &endpoint, int connections, int requests, int pipeline) {
+    /*
+     * Bundled client for the daemon: every connection gets its own thread,
+     * keeps `pipeline` requests in flight and records the round trip of each one
+     * Scrambles are seeded per connection so runs are repeatable
+     */
+
+    vector<vector<double>> latencies(connections);
+    atomic<int> failures(0);
+    auto start_time = chrono::high_resolution_clock::now();
+
+    vector<thread> clients;
+    for (int c = 0; c < connections; c++) {
+        clients.emplace_back([&, c]() {
+            int fd = open_socket(endpoint, false);
+            if (fd < 0) {
+                failures++;
+                return;
             }
-        }
+            mt19937 gen(1000 + c);
+            vector<chrono::high_resolution_clock::time_point> sent_at;
+            string pending;
+            char buf[65536];
+            int sent = 0, received = 0;
+            latencies[c].reserve(requests);
+
+            while (received < requests) {
+                string batch;
+                while (sent < requests && sent - received < pipeline) {
+                    batch += random_scramble(gen, 11) + '\n';
+                    sent_at.push_back(chrono::high_resolution_clock::now());
+                    sent++;
+                }
+                if (!batch.empty() && send(fd, batch.data(), batch.size(), MSG_NOSIGNAL) != (ssize_t) batch.size()) break;
+
+                ssize_t got = read(fd, buf, sizeof(buf));
+                if (got <= 0) break;
+                auto now = chrono::high_resolution_clock::now();
+                for (ssize_t i = 0; i < got; i++) {
+                    if (buf[i] != '\n') continue;
+                    latencies[c].push_back(chrono::duration<double, micro>(now - sent_at[received]).count());
+                    received++;
+                }
+            }
+            if (received < requests) failures++;
+            ::close(fd);
+        });
     }
+    for (auto &t : clients) t.join();
 
     auto end_time = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
-    cout << "Graph construction complete in " << duration.count() << " milliseconds\n";
+    double seconds = chrono::duration<double>(end_time - start_time).count();
+    vector<double> all;
+    for (auto &l : latencies) all.insert(all.end(), l.begin(), l.end());
+    if (all.empty()) {
+        cerr << "no responses from " << endpoint << "\n";
+        return 1;
+    }
+    sort(all.begin(), all.end());
+    auto pct = [&all](double p) { return all[min(all.size() - 1, (size_t) (p * all.size()))]; };
+
+    printf("requests\t%zu\n", all.size());
+    printf("connections\t%d\n", connections);
+    printf("pipeline\t%d\n", pipeline);
+    printf("failed_connections\t%d\n", failures.load());
+    printf("throughput_per_sec\t%.0f\n", all.size() / seconds);
+    printf("p50_us\t%.1f\n", pct(0.50));
+    printf("p90_us\t%.1f\n", pct(0.90));
+    printf("p99_us\t%.1f\n", pct(0.99));
+    printf("p999_us\t%.1f\n", pct(0.999));
+    printf("max_us\t%.1f\n", all.back());
+    return 0;
 }
 
+bool print_verify_report(const solver &engine, int threads, string &summary) {
+    // runs verify_engine and prints what it found, summary = one line for the daemon's health check
+    verify_report r = verify_engine(engine, threads);
+    auto line = [](const char *check, uint64_t errors, const string &ok) {
+        if (errors) printf("%s: FAILED (%llu wrong)\n", check, (unsigned long long) errors);
+        else printf("%s: ok (%s)\n", check, ok.c_str());
+    };
+    if (r.checksum_checked) line("table file", !r.checksum_ok, "payload matches the header checksum");
+    bool bijection = hash_self_check();
+    line("hash bijection", !bijection, "unhash gives every cube with UBL solved exactly once");
+    r.hash_errors += !bijection;
+    line("hashes", r.hash_errors, "cube_hash(unhash(h)) == h for all " + to_string(states) + " states, batch hashing agrees");
+    line("move tables", r.move_errors, "match cube_hash(apply_move(unhash(h), j))");
+    if (engine.graph) line("graph neighbours", r.graph_errors, "match cube_hash(apply_move(unhash(h), j))");
+    if (r.depths_checked) {
+        uint64_t errors = r.depth_errors + (r.solved_states != 1);
+        line("depths", errors, "1 state at depth 0, every edge within 1, every other state has a closer neighbour");
+        if (r.solved_states != 1) printf("    %llu states at depth 0\n", (unsigned long long) r.solved_states);
+    }
+    else printf("depths: not checked (the %s engine has no full table)\n", engine.name.c_str());
+    printf("verified in %.1f milliseconds with %d threads\n", r.milliseconds, threads);
+
+    char text[128];
+    snprintf(text, sizeof(text), "%s %s engine verified in %.0f ms", r.ok() ? "ok" : "fail", engine.name.c_str(),
+             r.milliseconds);
+    summary = text;
+    return r.ok();
+}
+
+void state_space_analytics(const solver &engine, const string &dir, int threads) {
+    /*
+     * Depth of every state, for whichever engine is loaded
+     * prints the depth distribution and writes the hashes at depth d to dir/depth_NN.bin (ascending uint32s,
+     * so picking a random state at some depth is one seek), the last non-empty file is the antipodes
+     *
+     * States go through in blocks, each block split into chunks across the threads
+     * Every chunk keeps its own per-depth lists (cleared and reused, so nothing is allocated per state),
+     * then the chunks are appended to the files in order, so only one block of hashes is ever in memory
+     */
+
+    const int block_size = 1 << 18;
+    const int chunk_size = 1 << 12;
+    const int chunks_per_block = block_size / chunk_size;
+
+    filesystem::create_directories(dir);
+    array<FILE *, max_moves + 1> files;
+    for (int d = 0; d <= max_moves; d++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/depth_%02d.bin", d);
+        files[d] = fopen((dir + name).c_str(), "wb");
+        if (!files[d]) {
+            cerr << "could not write " << dir << name << "\n";
+            return;
+        }
+    }
+
+    vector<array<vector<uint32_t>, max_moves + 1>> lists(chunks_per_block);
+    array<uint64_t, max_moves + 1> histogram = {};
+    auto start_time = chrono::high_resolution_clock::now();
+    for (int block = 0; block < states; block += block_size) {
+        int chunks = (min(states - block, block_size) + chunk_size - 1) / chunk_size;
+        parallel_for(threads, chunks, [&](int chunk) {
+            for (auto &list : lists[chunk]) list.clear();
+            int begin = block + chunk * chunk_size;
+            int end = min(states, begin + chunk_size);
+            for (int h = begin; h < end; h++) lists[chunk][engine.depth(h)].push_back(h);
+        });
+        for (int chunk = 0; chunk < chunks; chunk++) {
+            for (int d = 0; d <= max_moves; d++) {
+                const vector<uint32_t> &list = lists[chunk][d];
+                fwrite(list.data(), sizeof(uint32_t), list.size(), files[d]);
+                histogram[d] += list.size();
+            }
+        }
+    }
+    for (FILE *f : files) fclose(f);
+    auto end_time = chrono::high_resolution_clock::now();
 
+    int max_depth = 0;
+    uint64_t total = 0;
+    printf("depth\tstates\n");
+    for (int d = 0; d <= max_moves; d++) {
+        printf("%d\t%llu\n", d, (unsigned long long) histogram[d]);
+        if (histogram[d]) max_depth = d;
+        total += histogram[d];
+    }
+    printf("total\t%llu\n", (unsigned long long) total);
+    printf("antipodes: %llu states at depth %d (%s/depth_%02d.bin)\n", (unsigned long long) histogram[max_depth],
+           max_depth, dir.c_str(), max_depth);
+    printf("scanned in %.1f milliseconds with %d threads\n",
+           chrono::duration<double, milli>(end_time - start_time).count(), threads);
+}
 
-void solution(int hash, vector<pair<int, array<int, 9>>> &graph, string &sol_string) {
+void generate_scrambles(const solver &engine, long long count, uint64_t seed, int min_depth, int threads) {
     /*
-     * Uses a bit of a property of the way the graph was generated
+     * Random state scrambles, the way official ones are made: pick a uniformly random state,
+     * solve it optimally and print the inverse of the solution (so every scramble is as short as possible)
+     * With min_depth only states at least that far from solved are picked (still uniformly among those)
      *
-     * move 0 = F, so the 0th element of the adjacency list is (old cube + F)
-     * similary, 1 = F2 and so on
+     * Scrambles are made in chunks, and every chunk has its own RNG seeded from (seed, chunk number)
+     * so the output only depends on the seed, not on the thread count or which thread got which chunk
+     * Chunks are split across the threads a block at a time and written out in order, like batch mode
      *
-     * so we find the first element with a depth lower than the current cube, 
-     *  and add the corresponding move to the solution recursively.
-     *  (at max 12 recursions of O(1) operations so doesn't take long at all)
+     * Solutions come out in R, F, D, the x conjugation turns them into the usual R, U, F scramble moves
+     */
+
+    const int chunk_size = 1 << 12;
+    const int chunks_per_block = 64;
+    const array<uint8_t, 9> &to_ruf = wca_move_maps[22];
+    auto start_time = chrono::high_resolution_clock::now();
+    xoshiro256 probe(splitmix64(seed) ^ 0x5CA3B1E5ull);
+
+    // rejecting draws is fine unless almost everything gets rejected (e.g. depth 11 is 1 state in 1400)
+    // then it's faster to list every state that qualifies once and pick from the list
+    vector<uint32_t> candidates;
+    if (min_depth > 0) {
+        int accepted = 0;
+        for (int i = 0; i < 4096; i++) accepted += engine.depth(probe.below(states)) >= min_depth;
+        if (accepted < 4096 / 8) {
+            int scan_chunks = (states + chunk_size - 1) / chunk_size;
+            vector<vector<uint32_t>> lists(scan_chunks);
+            parallel_for(threads, scan_chunks, [&](int chunk) {
+                int end = min(states, (chunk + 1) * chunk_size);
+                for (int h = chunk * chunk_size; h < end; h++) {
+                    if (engine.depth(h) >= min_depth) lists[chunk].push_back(h);
+                }
+            });
+            for (const vector<uint32_t> &list : lists) candidates.insert(candidates.end(), list.begin(), list.end());
+            if (candidates.empty()) {
+                cerr << "no states are " << min_depth << " or more moves from solved\n";
+                return;
+            }
+        }
+    }
+
+    vector<string> results(chunks_per_block);
+    long long chunks = (count + chunk_size - 1) / chunk_size;
+    for (long long block = 0; block < chunks; block += chunks_per_block) {
+        int n = min<long long>(chunks - block, chunks_per_block);
+        parallel_for(threads, n, [&](int i) {
+            long long chunk = block + i;
+            xoshiro256 rng(splitmix64(seed) + chunk);
+            string &out = results[i];
+            out.clear();
+            move_buffer moves;
+            int scrambles = min<long long>(count - chunk * chunk_size, chunk_size);
+            for (int j = 0; j < scrambles; j++) {
+                int length;
+                if (!candidates.empty()) length = engine.solve(candidates[rng.below(candidates.size())], moves.data());
+                else {
+                    do length = engine.solve(rng.below(states), moves.data()); while (length >= 0 && length < min_depth);
+                }
+                if (length < 0) {
+                    out += string(solver::no_solution) + '\n';
+                    continue;
+                }
+                // inverse = reversed, with every turn the other way round (F <-> F', F2 stays)
+                for (int k = length - 1; k >= 0; k--) {
+                    int m = moves[k];
+                    out += move_names[to_ruf[3 * (m / 3) + 2 - m % 3]];
+                    if (k) out += ' ';
+                }
+                out += '\n';
+            }
+        });
+        for (int i = 0; i < n; i++) fwrite(results[i].data(), 1, results[i].size(), stdout);
+    }
+    fflush(stdout);
+
+    auto end_time = chrono::high_resolution_clock::now();
+    double seconds = chrono::duration<double>(end_time - start_time).count();
+    fprintf(stderr, "Generated %lld scrambles (seed %llu%s) in %.3f seconds (%.0f scrambles/sec, %d threads)\n",
+            count, (unsigned long long) seed, candidates.empty() ? "" : ", picked from a list of qualifying states",
+            seconds, count / max(seconds, 1e-9), threads);
+}
+
+template <typename puzzle_t>
+void puzzle_mode(const string &faces, long long generate, uint64_t seed, int threads) {
+    /*
+     * --puzzle: the same solving for a smaller move set, with its own table (depth_FACES.bin)
+     * Reads one scramble per line from stdin and prints "scramble<TAB>solution", or with --generate N
+     * prints N random state scrambles made only of those faces (same scheme as generate_scrambles)
      *
-     * if depth of cube = 0, cube is solved, we are done
+     * Scrambles are applied to a cube as usual, anything that moves a corner these faces can't reach
+     * gets "error: not in <R, U>" (or whichever faces) instead of a solution
      */
 
-    uint8_t depth = graph[hash].first;
-    if (depth == 0) return;
-    else {
-        for (int i = 0; i < 9; i++) { 
-            if (graph[graph[hash].second[i]].first == depth - 1) {
-
-                if (i == 0) sol_string = sol_string + (string) "F ";
-                else if (i == 1) sol_string  = sol_string + (string) "F2 ";
-                else if (i == 2) sol_string = sol_string + (string) "F' ";
-                else if (i == 3) sol_string = sol_string + (string) "D ";
-                else if (i == 4) sol_string = sol_string + (string) "D2 ";
-                else if (i == 5) sol_string = sol_string + (string) "D' " ;
-                else if (i == 6) sol_string = sol_string + (string) "R ";
-                else if (i == 7) sol_string = sol_string + (string) "R2 ";
-                else if (i == 8) sol_string = sol_string + (string) "R' ";
-
-                solution(graph[hash].second[i], graph, sol_string);
-
-                break;
+    puzzle_engine<puzzle_t> engine;
+    string error;
+    if (!engine.load(table_dir + "/depth_" + faces + ".bin", puzzle_t::layout, threads, error)) {
+        cerr << error << "\n";
+        exit(1);
+    }
+
+    string group = "<";
+    for (char face : faces) group += group.size() > 1 ? string(", ") + face : string(1, face);
+    group += ">";
+
+    vector<uint8_t> moves;
+    if (generate) {
+        xoshiro256 rng(splitmix64(seed));
+        for (long long i = 0; i < generate;) {
+            int state = rng.below(puzzle_t::state_count);
+            if (!engine.reachable(state)) continue; // only for move sets that reach part of their coordinates
+            if (!engine.scramble(state, moves)) {
+                cerr << "the " << group << " table has no solution for state " << state << " (corrupt table?)\n";
+                exit(1);
             }
+            printf("%s\n", engine.move_text(moves).c_str());
+            i++;
         }
+        return;
+    }
+
+    string line;
+    while (getline(cin, line)) {
+        cube c = solved[0];
+        scramble_error error;
+        string result;
+        if (!c.apply_scramble(line, error)) result = "error at " + to_string(error.offset) + ": " + error.reason;
+        else if (int state = puzzle_t::state(c); !engine.reachable(state)) result = "error: not in " + group;
+        else if (!engine.solve(state, moves)) result = "error: the table has no solution for this state (corrupt table)";
+        else result = engine.move_text(moves);
+        printf("%s\t%s\n", line.c_str(), result.c_str());
+    }
+}
+
+bool write_embedded_table(const string &path, int threads) {
+    // fresh BFS -> compressed table -> header with it as arrays, to be picked up by the next build
+
+    vector<uint8_t> payload(depth_table::bytes);
+    make_table_parallel(payload, threads);
+    compressed_table ct = compress_depth_table(payload.data());
+
+    string tmp_path = path + ".tmp" + to_string(getpid());
+    FILE *f = fopen(tmp_path.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "// Generated by ./solver --embed-table, do not edit\n"
+               "// depth table (depth mod 3 of every state), Huffman coded, see compress_depth_table in solver.hpp\n\n"
+               "#ifndef DEPTH_TABLE_DATA_HPP\n#define DEPTH_TABLE_DATA_HPP\n\n");
+    fprintf(f, "const uint64_t embedded_table_checksum = %lluULL;\n\n",
+            (unsigned long long) table_checksum(payload.data(), payload.size()));
+    fprintf(f, "const uint8_t embedded_code_lengths[%d] = {", table_symbols);
+    for (int s = 0; s < table_symbols; s++) fprintf(f, "%s%d", s == 0 ? "\n    " : s % 32 ? "," : ",\n    ", ct.lengths[s]);
+    fprintf(f, "\n};\n\nconst uint8_t embedded_stream[%zu] = {", ct.stream.size());
+    for (size_t i = 0; i < ct.stream.size(); i++) fprintf(f, "%s%d", i == 0 ? "\n    " : i % 32 ? "," : ",\n    ", ct.stream[i]);
+    fprintf(f, "\n};\n\n#endif\n");
+    bool ok = !ferror(f);
+    ok = fclose(f) == 0 && ok;
+
+    error_code ec;
+    if (ok) filesystem::rename(tmp_path, path, ec);
+    cout << "compressed " << payload.size() << " bytes to " << ct.stream.size() << " bytes ("
+         << 8.0 * ct.stream.size() / states << " bits per state)\n";
+    return ok && !ec;
+}
+
+int check_embedded_table(int threads) {
+    // the compiled in table against a fresh BFS, byte for byte
+
+    const vector<uint8_t> &embedded = get_embedded_table();
+    if (embedded.empty()) {
+        cout << "no embedded table in this build (see --embed-table)\n";
+        return 1;
+    }
+    vector<uint8_t> payload(depth_table::bytes);
+    make_table_parallel(payload, threads);
+    size_t mismatches = 0;
+    for (int h = 0; h < states; h++) mismatches += depth_table::get(embedded.data(), h) != depth_table::get(payload.data(), h);
+    cout << (mismatches ? "embedded table differs from the BFS in " + to_string(mismatches) + " states\n"
+                        : "embedded table matches the BFS\n");
+    return mismatches ? 1 : 0;
+}
+
+void print_all_solutions(const solver &engine, cube c, size_t limit) {
+    // count of optimal solutions plus up to limit of them, depth table only
+    const array<uint8_t, 9> &map = wca_move_maps[c.find_orientation()];
+    c.rotate_to_wca();
+    int hash = cube_hash(c);
+
+    unordered_map<int, uint64_t> memo;
+    solution_arena arena;
+    enumerate_optimal_solutions(hash, engine.table, arena, limit);
+    cout << count_optimal_solutions(hash, engine.table, memo) << " optimal solutions of length " << arena.length << ":\n";
+    for (size_t i = 0; i < arena.count; i++) {
+        uint8_t moves[max_moves];
+        for (int k = 0; k < arena.length; k++) moves[k] = map[arena[i][k]];
+        cout << "    " << format_moves(moves, arena.length) << "\n";
     }
 }
 
+void optimal_counts_report(const solver &engine, int threads) {
+    // whole state space: time to count every state's optimal solutions, and how they're distributed
 
-int main() {    
+    auto start_time = chrono::high_resolution_clock::now();
+    vector<uint32_t> counts = all_optimal_counts(engine.table, threads);
+    auto end_time = chrono::high_resolution_clock::now();
+
+    uint64_t total = 0;
+    int most = 0;
+    for (int h = 0; h < states; h++) {
+        total += counts[h];
+        if (counts[h] > counts[most]) most = h;
+    }
+    printf("counted optimal solutions of %d states in %.1f milliseconds\n", states,
+           chrono::duration<double, milli>(end_time - start_time).count());
+    printf("average %.2f per state, most is %u (hash %d)\n", (double) total / states, counts[most], most);
+}
+
+/*
+ * Benchmark suite
+ *
+ * Every case runs over a fixed corpus made from a seeded RNG, so two runs (or two builds) see the same inputs
+ * Ops are timed in small batches; per-op latency of a batch = batch time / batch size,
+ * and the percentiles are over those batches (timing single ns-scale ops mostly measures the clock)
+ *
+ * Output is one tab separated line per case:
+ * name, ops, ns_per_op, ops_per_sec, p50_ns, p90_ns, p99_ns, p999_ns
+ */
+
+volatile uint64_t bench_sink; // results get added here so the compiler can't drop the work
+
+template <typename fn_t>
+void bench_case(const string &name, int ops, int batch, fn_t fn) {
+    vector<double> samples;
+    samples.reserve(ops / batch + 1);
+    auto start_time = chrono::high_resolution_clock::now();
+    for (int i = 0; i < ops; i += batch) {
+        int end = min(ops, i + batch);
+        auto batch_start = chrono::high_resolution_clock::now();
+        for (int k = i; k < end; k++) fn(k);
+        auto batch_end = chrono::high_resolution_clock::now();
+        samples.push_back(chrono::duration<double, nano>(batch_end - batch_start).count() / (end - i));
+    }
+    auto end_time = chrono::high_resolution_clock::now();
+
+    double total_ns = chrono::duration<double, nano>(end_time - start_time).count();
+    sort(samples.begin(), samples.end());
+    auto pct = [&samples](double p) { return samples[min(samples.size() - 1, (size_t) (p * samples.size()))]; };
+    printf("%s\t%d\t%.1f\t%.0f\t%.1f\t%.1f\t%.1f\t%.1f\n", name.c_str(), ops, total_ns / ops,
+           ops / (total_ns * 1e-9), pct(0.5), pct(0.9), pct(0.99), pct(0.999));
+    fflush(stdout);
+}
+
+void benchmark_suite(int threads) {
+    const int corpus_size = 1 << 14;
+    const int mask = corpus_size - 1;
+    mt19937 gen(20240601);
+
+    vector<cube> cubes(corpus_size);
+    vector<int> hashes(corpus_size);
+    vector<string> scrambles(corpus_size);
+    for (int i = 0; i < corpus_size; i++) {
+        cubes[i] = random_cube(gen);
+        hashes[i] = gen() % states;
+        scrambles[i] = random_scramble(gen, 11);
+    }
+
+    solver depth, sym;
+    depth.name = "depth";
+    sym.name = "sym";
+    load_or_exit(depth, threads);
+    load_or_exit(sym, threads);
+
+    vector<string> solutions(corpus_size);
+    move_buffer moves;
+    for (int i = 0; i < corpus_size; i++) {
+        int length = solution(hashes[i], depth.table, moves.data());
+        solutions[i] = format_moves(moves.data(), length);
+    }
+
+    if (!hash_self_check()) cerr << "cube_hash/unhash are not a bijection over the state space\n";
+    if (!packed_cube_self_check()) cerr << "packed_cube moves/rotations disagree with cube\n";
+    if (!batch_hash_self_check()) cerr << "hash_batch/unhash_batch disagree with cube_hash/unhash\n";
+    if (!orientation_tables_self_check()) cerr << "wca_move_maps disagree with str_rotate\n";
+
+    printf("name\tops\tns_per_op\tops_per_sec\tp50_ns\tp90_ns\tp99_ns\tp999_ns\n");
+
+    bench_case("cube_hash", 1 << 22, 64, [&](int i) {
+        bench_sink += cube_hash(cubes[i & mask]);
+    });
+    bench_case("unhash", 1 << 22, 64, [&](int i) {
+        bench_sink += unhash(hashes[i & mask]).pieces[3];
+    });
+    // batch versions: one op = the whole corpus, so ns_per_op / corpus_size is the time per cube
+    vector<int> batch_hashes(corpus_size);
+    vector<cube> batch_cubes(corpus_size);
+    bench_case("hash_batch/16384", 256, 1, [&](int) {
+        hash_batch(cubes.data(), corpus_size, batch_hashes.data());
+        bench_sink += batch_hashes[7];
+    });
+    bench_case("unhash_batch/16384", 256, 1, [&](int) {
+        unhash_batch(hashes.data(), corpus_size, batch_cubes.data());
+        bench_sink += batch_cubes[7].pieces[3];
+    });
+    cube moved = solved[0];
+    bench_case("cube::apply_move", 1 << 22, 64, [&](int i) {
+        moved.apply_move(i % 18);
+        bench_sink += moved.pieces[1];
+    });
+    packed_cube packed(solved[0]);
+    bench_case("packed_cube::apply_move", 1 << 22, 64, [&](int i) {
+        packed.apply_move(i % 18);
+        bench_sink += packed.bytes[1];
+    });
+    bench_case("packed_cube::apply_move<R>", 1 << 22, 64, [&](int) {
+        packed.apply_move<6>();
+        bench_sink += packed.bytes[1];
+    });
+    bench_case("cube::apply_rotation(z')", 1 << 22, 64, [&](int) {
+        moved.apply_rotation(2);
+        bench_sink += moved.pieces[1];
+    });
+    bench_case("packed_cube::apply_rotation(z')", 1 << 22, 64, [&](int) {
+        packed.apply_rotation(2);
+        bench_sink += packed.bytes[1];
+    });
+    bench_case("move_tables::neighbour", 1 << 22, 64, [&](int i) {
+        bench_sink += get_move_tables().neighbour(hashes[i & mask], i % 9);
+    });
+    // the corpus as one text, like a mapped file (ops = scrambles, 11 moves each)
+    string corpus_text;
+    for (const string &scr : scrambles) corpus_text += scr + '\n';
+    vector<uint8_t> parsed;
+    scramble_error parse_error;
+    bench_case("parse_scramble", 1 << 20, 64, [&](int i) {
+        parse_scramble(scrambles[i & mask], parsed, parse_error);
+        bench_sink += parsed.size();
+    });
+    bench_case("parse_corpus/16384", 64, 1, [&](int) {
+        string_view text = corpus_text;
+        for (size_t pos = 0, end; pos < text.size(); pos = end + 1) {
+            end = text.find('\n', pos);
+            parse_scramble(text.substr(pos, end - pos), parsed, parse_error);
+            bench_sink += parsed.size();
+        }
+    });
+    string facelets = "WWWWRRRRGGGGYYYYOOOOBBBB";
+    bench_case("cube::set_facelets", 1 << 20, 64, [&](int) {
+        cube c;
+        bench_sink += c.set_facelets(facelets, parse_error);
+    });
+    bench_case("apply_scramble", 1 << 19, 16, [&](int i) {
+        cube c = solved[0];
+        c.apply_scramble(scrambles[i & mask]);
+        bench_sink += c.pieces[2];
+    });
+    bench_case("rotate_to_wca", 1 << 21, 64, [&](int i) {
+        cube c = cubes[i & mask];
+        c.rotate_to_wca();
+        bench_sink += c.pieces[4];
+    });
+    bench_case("str_rotate", 1 << 18, 16, [&](int i) {
+        string sol = solutions[i & mask];
+        str_rotate(sol, i % 24);
+        bench_sink += sol.size();
+    });
+    bench_case("wca_move_maps", 1 << 21, 64, [&](int i) {
+        const array<uint8_t, 9> &map = wca_move_maps[i % 24];
+        move_buffer mapped;
+        for (int k = 0; k < 9; k++) mapped[k] = map[(i + k) % 9];
+        bench_sink += mapped[i % 9];
+    });
+    bench_case("solution_depth", 1 << 19, 16, [&](int i) {
+        bench_sink += solution(hashes[i & mask], depth.table, moves.data());
+    });
+    bench_case("solution_sym", 1 << 19, 16, [&](int i) {
+        bench_sink += solution(hashes[i & mask], sym.sym_table, moves.data());
+    });
+    bench_case("solution_ida", 1 << 11, 1, [&](int i) {
+        bench_sink += ida_solution(hashes[i & mask], moves.data());
+    });
+    bench_case("solve_uninstrumented", 1 << 19, 16, [&](int i) {
+        // solver::solve's steps with no stage_timers, the baseline for what metrics cost when they're off
+        cube c = cubes[i & mask];
+        const array<uint8_t, 9> &map = wca_move_maps[c.find_orientation()];
+        c.rotate_to_wca();
+        int length = depth.solve(cube_hash(c), moves.data());
+        for (int k = 0; k < length; k++) moves[k] = map[moves[k]];
+        bench_sink += length;
+    });
+    bench_case("solver::solve", 1 << 19, 16, [&](int i) {
+        bench_sink += depth.solve(cubes[i & mask], moves);
+    });
+    bench_case("solve_scramble", 1 << 18, 16, [&](int i) {
+        bench_sink += depth.solve_scramble(scrambles[i & mask]).size();
+    });
+    // same two again with metrics on, the difference is the cost of recording (off costs one branch per call)
+    bool metrics_were_on = solver_metrics.enabled.exchange(true);
+    bench_case("solver::solve+metrics", 1 << 19, 16, [&](int i) {
+        bench_sink += depth.solve(cubes[i & mask], moves);
+    });
+    bench_case("solve_scramble+metrics", 1 << 18, 16, [&](int i) {
+        bench_sink += depth.solve_scramble(scrambles[i & mask]).size();
+    });
+    solver_metrics.enabled = metrics_were_on;
+
+    vector<uint8_t> payload(depth_table::bytes);
+    bench_case("table_build_depth", 3, 1, [&](int) {
+        make_table_parallel(payload, threads);
+        bench_sink += payload[12345];
+    });
+    bench_case("table_load_depth", 64, 1, [&](int) {
+        mapped_table table_file;
+        string error;
+        table_file.open((table_dir + "/depth.bin").c_str(), LAYOUT_DEPTH2, depth_table::bytes, error);
+        bench_sink += table_file.size();
+    });
+}
+
+int main(int argc, char **argv) {    
     
-    // Initializing RNG to generate random cubes if necessary
-    random_device rd;
-    linear_congruential_engine<std::uint_fast32_t, 48271, 0, 2147483647> rng;
-    rng.seed(rd());
-
-    //Making graph
-    vector<pair<int, array<int, 9>>> graph(states, { 20, {-1, -1, -1, -1, -1, -1, -1, -1, -1} });
-    make_graph(graph);
-
-    //cube test = random_cube(rng);
-    //test.draw();
-    //cout << cube_hash(test) << endl;
-    //test = unhash(cube_hash(test));
-    //test.draw();
-    //
-    // sample code for random cube ^
+    // --engine picks how cubes are solved:
+    //      depth (default) = compact depth table (~0.9 MB)
+    //      graph = the old adjacency graph (~147 MB), --graph for short
+    //      sym = depth table reduced by the 3 rotations that swap R, F and D and their mirror images (~0.15 MB)
+    //      ida = no big table at all, IDA* with small pruning tables (for short lived runs / tight memory)
+    //      mitm = states within k moves of solved + a forward search to them, k set with --mitm-depth K (default 6)
+    // --threads N sets the number of threads used to build tables and solve batches (default: all cores)
+    // --tables DIR reads the table files from DIR, and builds them there if they are missing (default: .)
+    // --batch [FILE] solves one scramble per line from FILE (or stdin) and prints "scramble<TAB>solution"
+    // --serve ENDPOINT runs as a daemon on a Unix socket path, or on 127.0.0.1:PORT if ENDPOINT is a number
+    // --loadgen ENDPOINT measures a running daemon (--connections C, --requests N per connection, --pipeline P)
+    // --all-solutions N also prints how many optimal solutions there are, and up to N of them (depth engine)
+    // --optimal-counts counts the optimal solutions of every state and exits (depth engine)
+    // --bench runs the benchmark suite (seeded inputs, tab separated results) and exits
+    // --bfs-scaling times table generation from 1 to N threads and exits
+    // --interleave-bench N times one at a time solving against interleaved batches of 1 to 64 lanes and exits
+    // --engine-bench N compares the depth, sym, ida and mitm (k = 3 to 8) engines on N random states and exits
+    // --analytics DIR prints the depth distribution and writes the hashes at each depth to DIR, then exits
+    // --embed-table FILE writes the compressed depth table as a header, to compile into the binary, and exits
+    // --check-embedded compares the compiled in table with a fresh BFS and exits
+    // --generate N prints N random state scrambles (--seed S to repeat a run, --min-depth D for hard ones only)
+    // --puzzle RU|RUF solves scrambles for the 2x2 turned with only those faces, one per line from stdin
+    //      (own table, optimal in that move set), with --generate N it makes N scrambles for it instead
+    // --verify checks the loaded tables against the cube (hashes, moves, depths) and exits, 1 if anything is wrong
+    //      with --serve it runs before serving instead (the daemon won't start on bad tables, "health" reports it)
+    // --metrics json|prometheus records per-stage latencies, dumped to stderr on exit and on SIGUSR1
+    status_log = &cout; // table build/load progress, goes to stderr along with cout in the modes that redirect it
+    solver engine;
+    bool bfs_scaling = false;
+    bool batch = false;
+    string batch_file;
+    string serve_endpoint, loadgen_endpoint;
+    int connections = 4, requests = 100000, pipeline = 16;
+    int engine_bench = 0;
+    int interleave_bench = 0;
+    int all_solutions = 0;
+    bool optimal_counts = false;
+    bool bench = false;
+    string analytics_dir;
+    string embed_file;
+    bool check_embedded = false;
+    bool verify = false;
+    long long generate = 0;
+    uint64_t seed = random_device{}();
+    int min_depth = 0;
+    string puzzle;
+    int threads = max(1u, thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--graph") == 0) engine.name = "graph";
+        else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) engine.name = argv[++i];
+        else if (strcmp(argv[i], "--mitm-depth") == 0 && i + 1 < argc) engine.mitm_depth = min(max_moves, max(0, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--tables") == 0 && i + 1 < argc) table_dir = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') batch_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) serve_endpoint = argv[++i];
+        else if (strcmp(argv[i], "--loadgen") == 0 && i + 1 < argc) loadgen_endpoint = argv[++i];
+        else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) connections = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) requests = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) pipeline = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--all-solutions") == 0 && i + 1 < argc) all_solutions = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--optimal-counts") == 0) optimal_counts = true;
+        else if (strcmp(argv[i], "--bench") == 0) bench = true;
+        else if (strcmp(argv[i], "--bfs-scaling") == 0) bfs_scaling = true;
+        else if (strcmp(argv[i], "--engine-bench") == 0 && i + 1 < argc) engine_bench = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--interleave-bench") == 0 && i + 1 < argc) interleave_bench = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) metrics_format = argv[++i];
+        else if (strcmp(argv[i], "--analytics") == 0 && i + 1 < argc) analytics_dir = argv[++i];
+        else if (strcmp(argv[i], "--embed-table") == 0 && i + 1 < argc) embed_file = argv[++i];
+        else if (strcmp(argv[i], "--check-embedded") == 0) check_embedded = true;
+        else if (strcmp(argv[i], "--verify") == 0) verify = true;
+        else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) generate = max(1ll, atoll(argv[++i]));
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--min-depth") == 0 && i + 1 < argc) min_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--puzzle") == 0 && i + 1 < argc) puzzle = argv[++i];
+    }
+    if (engine.name != "depth" && engine.name != "graph" && engine.name != "sym" && engine.name != "ida" &&
+        engine.name != "mitm") {
+        cerr << "unknown engine " << engine.name << " (expected depth, graph, sym, ida or mitm)\n";
+        return 1;
+    }
+
+    if (!metrics_format.empty()) {
+        if (metrics_format != "json" && metrics_format != "prometheus") {
+            cerr << "unknown metrics format " << metrics_format << " (expected json or prometheus)\n";
+            return 1;
+        }
+        solver_metrics.enabled = true;
+        signal(SIGUSR1, request_metrics_dump);
+    }
+
+    if ((all_solutions || optimal_counts) && engine.name != "depth") {
+        cerr << "--all-solutions and --optimal-counts need the depth engine\n";
+        return 1;
+    }
+
+    if (bench) {
+        cout.rdbuf(cerr.rdbuf()); // only results on stdout
+        benchmark_suite(threads);
+        return 0;
+    }
+    if (bfs_scaling) {
+        status_log = &cerr; // build progress off stdout, the report itself is written with cout
+        bfs_scaling_report(threads);
+        return 0;
+    }
+    if (engine_bench) {
+        cout.rdbuf(cerr.rdbuf()); // only results on stdout
+        engine_benchmark(engine_bench, threads);
+        return 0;
+    }
+    if (interleave_bench) {
+        cout.rdbuf(cerr.rdbuf()); // only results on stdout
+        interleave_benchmark(interleave_bench, threads);
+        return 0;
+    }
+
+    if (!puzzle.empty()) {
+        cout.rdbuf(cerr.rdbuf()); // only results on stdout
+        if (puzzle == "RU") puzzle_mode<ru_puzzle>(puzzle, generate, seed, threads);
+        else if (puzzle == "RUF") puzzle_mode<ruf_puzzle>(puzzle, generate, seed, threads);
+        else {
+            cerr << "unknown puzzle " << puzzle << " (expected RU or RUF)\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!embed_file.empty()) {
+        if (write_embedded_table(embed_file, threads)) return 0;
+        cerr << "could not write " << embed_file << "\n";
+        return 1;
+    }
+    if (check_embedded) return check_embedded_table(threads);
+    if (!analytics_dir.empty()) {
+        load_or_exit(engine, threads);
+        state_space_analytics(engine, analytics_dir, threads);
+        return 0;
+    }
+    if (generate) {
+        cout.rdbuf(cerr.rdbuf()); // only scrambles on stdout
+        load_or_exit(engine, threads);
+        generate_scrambles(engine, generate, seed, min_depth, threads);
+        return 0;
+    }
+    if (optimal_counts) {
+        load_or_exit(engine, threads);
+        optimal_counts_report(engine, threads);
+        return 0;
+    }
+    if (!loadgen_endpoint.empty()) return load_generator(loadgen_endpoint, connections, requests, pipeline);
+    if (!serve_endpoint.empty()) {
+        engine.progressive = !verify; // verifying needs the whole table first
+        load_or_exit(engine, threads);
+        if (verify && !print_verify_report(engine, threads, health_status)) {
+            cerr << "tables failed verification, not serving\n";
+            return 1;
+        }
+        return serve(engine, serve_endpoint, threads);
+    }
+    if (verify) {
+        load_or_exit(engine, threads);
+        return print_verify_report(engine, threads, health_status) ? 0 : 1;
+    }
+
+    if (batch) {
+        // status messages go to stderr, stdout is only for results
+        cout.rdbuf(cerr.rdbuf());
+        load_or_exit(engine, threads);
+        if (batch_file.empty()) batch_solve(engine, cin, nullptr, threads);
+        else {
+            mapped_file in;
+            string error;
+            if (!in.open(batch_file.c_str(), error)) {
+                cerr << "could not open " << batch_file << " (" << error << ")\n";
+                return 1;
+            }
+            batch_solve(engine, cin, &in, threads);
+        }
+        if (!metrics_format.empty()) dump_metrics();
+        return 0;
+    }
+
+    engine.progressive = !all_solutions; // --all-solutions reads the finished table directly
+    load_or_exit(engine, threads);
+
+    if (!metrics_format.empty()) {
+        // no SA_RESTART, so SIGUSR1 interrupts the wait for the next line and the dump happens straight away
+        struct sigaction sa = {};
+        sa.sa_handler = request_metrics_dump;
+        sigaction(SIGUSR1, &sa, nullptr);
+    }
 
     while (true) {
         // loop to get solutions of cube given scramble
 
         cube test = solved[0];
+        scramble_error error;
         string scr;
         cout << "input a scramble:\n";
         fflush(stdin);
-        getline(cin, scr);
-        test.apply_scramble(scr);
+        if (!getline(cin, scr)) {
+            if (!metrics_dump_requested.exchange(false)) break;
+            dump_metrics();
+            cin.clear();
+            clearerr(stdin);
+            continue;
+        }
+        if (metrics_dump_requested.exchange(false)) dump_metrics();
+        {
+            // parsed once, the drawing, the solution and the enumeration are all of this cube
+            stage_timer timer(STAGE_PARSE);
+            if (!solver::read_scramble(scr, test, error)) {
+                cout << "error at " << error.offset << ": " << error.reason << endl;
+                continue;
+            }
+        }
 
         cout << "The scrambled cube is:\n";
         test.draw();
-        string sol_string = "";
-        int ort = test.find_orientation();
-        test.rotate_to_wca();
-        solution(cube_hash(test), graph, sol_string);
-        str_rotate(sol_string, ort);
-        cout << sol_string << endl;
+        cout << engine.solve_text(test) << endl;
+        if (all_solutions) print_all_solutions(engine, test, all_solutions);
     }
+    if (!metrics_format.empty()) dump_metrics();
 
     return 0;
 }
@@ -0,0 +1,2504 @@
+#ifndef SOLVER_HPP
+#define SOLVER_HPP
+
+#include "cube.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+/*
+ * Solver library
+ *
+ * Everything needed to build/load tables and solve cubes, with no main() and no interactive IO
+ * solver.cpp is the command line front end built on top of it
+ */
+
+const int states = 3674160;
+// Number of states
+
+inline ostream *status_log = nullptr;
+// Where building/loading tables reports progress (tables rebuilt, BFS layers, load times)
+// nothing is written when it's null, so a program using the library keeps its stdout; solver.cpp points it at cout
+
+struct move_tables {
+    /*
+     * The hash is split into two coordinates:
+     *      perm = hash / 729 (Lehmer code of the corners, 0 to 5039)
+     *      orie = hash % 729 (ternary orientation digits, 0 to 728)
+     *
+     * R, F and D move pieces between fixed positions and twist fixed positions,
+     * so what a move does to perm only depends on perm, and what it does to orie only depends on orie
+     *
+     * So we precompute both once with cube::apply_move, and
+     * a neighbour becomes 2 array lookups instead of unhash -> apply_move -> cube_hash
+     *
+     * This is also the puzzle description of the R/F/D engine, see corner_subgroup for the others
+     */
+
+    static constexpr int state_count = states;
+    static constexpr int move_count = 9;
+    static constexpr int max_moves = 11; // God's number, longest solution walk
+    // moves are cube::apply_move 0 to 8
+
+    array<array<int, 9>, 5040> perm_move;
+    array<array<int, 9>, 729> orie_move;
+
+    move_tables() {
+        for (int p = 0; p < 5040; p++) {
+            cube cur = unhash(p * 729);
+            for (int j = 0; j < 9; j++) {
+                cube c = cur;
+                c.apply_move(j);
+                perm_move[p][j] = cube_hash(c) / 729;
+            }
+        }
+
+        for (int o = 0; o < 729; o++) {
+            cube cur = unhash(o);
+            for (int j = 0; j < 9; j++) {
+                cube c = cur;
+                c.apply_move(j);
+                orie_move[o][j] = cube_hash(c) % 729;
+            }
+        }
+    }
+
+    int neighbour(int hash, int move) const {
+        return perm_move[hash / 729][move] * 729 + orie_move[hash % 729][move];
+    }
+
+    static int cube_move(int move) {
+        return move;
+    }
+
+    static int inverse(int move) {
+        return 3 * (move / 3) + 2 - move % 3;
+    }
+};
+
+inline const move_tables &get_move_tables() {
+    // built on first use, shared by everything after that
+    static const move_tables tables;
+    return tables;
+}
+
+inline double cube_expansion_extra_ns() {
+    /*
+     * How much longer expanding one state (all 9 neighbours) takes through unhash -> apply_move -> cube_hash,
+     * what the BFS did before the move tables, than through the move tables
+     * Timed once on a sample of states spread over the whole range, so builds can report what the tables save
+     */
+    static const double extra = [] {
+        const move_tables &mt = get_move_tables();
+        const int sample = 4096;
+        volatile int sink = 0;
+        auto start_time = chrono::high_resolution_clock::now();
+        for (int i = 0; i < sample; i++) {
+            cube cur = unhash((int) ((int64_t) i * states / sample));
+            for (int j = 0; j < 9; j++) {
+                cube c = cur;
+                c.apply_move(j);
+                sink = sink + cube_hash(c);
+            }
+        }
+        auto cube_time = chrono::high_resolution_clock::now();
+        for (int i = 0; i < sample; i++) {
+            int hash = (int) ((int64_t) i * states / sample);
+            for (int j = 0; j < 9; j++) sink = sink + mt.neighbour(hash, j);
+        }
+        auto end_time = chrono::high_resolution_clock::now();
+        return max(0.0, chrono::duration<double, nano>((cube_time - start_time) - (end_time - cube_time)).count() / sample);
+    }();
+    return extra;
+}
+
+inline void print_bfs_time(chrono::high_resolution_clock::time_point start_time, int threads) {
+    // BFS time over every state, next to the estimate for the same BFS without move tables
+    if (!status_log) return;
+    double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start_time).count();
+    double cube_ms = ms + states * cube_expansion_extra_ns() / threads * 1e-6;
+    char speedup[32];
+    snprintf(speedup, sizeof(speedup), "%.1fx", cube_ms / max(ms, 1.0));
+    *status_log << "BFS done in " << (long long) ms << " milliseconds, about " << (long long) cube_ms
+                << " with unhash/apply_move/cube_hash instead of move tables (" << speedup << " speedup)\n";
+}
+
+/*
+ * Tables are cached on disk as header + payload, and memory mapped read-only when loading
+ * so every solver process on the machine shares one page cache copy instead of reading its own
+ *
+ * The header is checked before the payload is used, anything that doesn't match
+ * (old headerless files, other versions, truncated files) is rebuilt
+ * The checksum covers the whole payload: the small tables check it on every open (well under a millisecond),
+ * the graph only in the background once it is in use (touching every page is ~50 ms, see solver::check_graph)
+ */
+
+const char table_magic[8] = {'2', 'x', '2', 'T', 'A', 'B', 'L', 'E'};
+const uint32_t table_version = 1;
+
+enum table_layout : uint32_t {
+    LAYOUT_GRAPH = 1,  // graph_node per state
+    LAYOUT_DEPTH2 = 2, // 2 bit depth mod 3 per state
+    LAYOUT_SYM6 = 5    // 2 bit depth mod 3 per representative of the 6 R/F/D symmetries (3 was the rotations only table)
+};
+
+struct table_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;
+    uint32_t states;
+    uint32_t header_size;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+inline uint64_t table_checksum(const uint8_t *data, size_t size) {
+    // FNV-1a over 8 byte words, with the high half folded back in after every step
+    uint64_t h = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * 1099511628211ULL;
+        h ^= h >> 32;
+    }
+    for (; i < size; i++) h = (h ^ data[i]) * 1099511628211ULL;
+    return h;
+}
+
+class mapped_file {
+    // a whole file mapped read only (table files, scramble corpora)
+    public:
+        mapped_file() = default;
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        ~mapped_file() { close(); }
+
+        bool open(const char *path, string &error) {
+            close();
+
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0) { error = "missing"; return false; }
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                ::close(fd);
+                error = "can't stat";
+                return false;
+            }
+
+            length = st.st_size;
+            if (length) base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd); // the mapping keeps the file alive
+            if (base == MAP_FAILED) {
+                base = nullptr;
+                length = 0;
+                error = "mmap failed";
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+            if (base) munmap(base, length);
+            base = nullptr;
+            length = 0;
+        }
+
+        const uint8_t *data() const {
+            return reinterpret_cast<const uint8_t *>(base);
+        }
+
+        size_t size() const {
+            return length;
+        }
+
+        string_view view() const {
+            return string_view(reinterpret_cast<const char *>(base), length);
+        }
+
+    private:
+        void *base = nullptr;
+        size_t length = 0;
+};
+
+class mapped_table {
+    public:
+        bool open(const char *path, uint32_t layout, uint64_t payload_size, string &error,
+                  uint32_t state_count = states) {
+            // maps the file and checks its header and size (not the checksum, see checksum_ok),
+            // returns false with the reason if it can't be used
+            if (!file.open(path, error)) return false;
+            if (file.size() < sizeof(table_header)) error = "truncated";
+            else {
+                const table_header &h = header();
+                if (memcmp(h.magic, table_magic, sizeof(table_magic)) != 0) error = "bad magic";
+                else if (h.version != table_version) error = "version " + to_string(h.version);
+                else if (h.layout != layout) error = "layout " + to_string(h.layout);
+                else if (h.states != state_count) error = "state count " + to_string(h.states);
+                else if (h.header_size != sizeof(table_header) || h.payload_size != payload_size) error = "bad sizes";
+                else if (file.size() != sizeof(table_header) + payload_size) error = "truncated";
+                else return true;
+            }
+
+            close();
+            return false;
+        }
+
+        void close() {
+            file.close();
+        }
+
+        bool checksum_ok() const {
+            // reads the whole payload
+            return table_checksum(payload(), header().payload_size) == header().checksum;
+        }
+
+        bool verify(string &error) {
+            // checksum_ok, closing the table with the reason if it fails
+            if (checksum_ok()) return true;
+            error = "checksum mismatch";
+            close();
+            return false;
+        }
+
+        const table_header &header() const {
+            return *reinterpret_cast<const table_header *>(file.data());
+        }
+
+        const uint8_t *payload() const {
+            return file.data() + sizeof(table_header);
+        }
+
+        size_t size() const {
+            return file.size();
+        }
+
+    private:
+        mapped_file file;
+};
+
+inline table_header make_table_header(uint32_t layout, const uint8_t *payload, uint64_t payload_size,
+                                      uint32_t state_count = states) {
+    table_header h = {};
+    memcpy(h.magic, table_magic, sizeof(table_magic));
+    h.version = table_version;
+    h.layout = layout;
+    h.states = state_count;
+    h.header_size = sizeof(table_header);
+    h.payload_size = payload_size;
+    h.checksum = table_checksum(payload, payload_size);
+    return h;
+}
+
+inline bool write_table(const char *path, uint32_t layout, const vector<uint8_t> &payload,
+                        uint32_t state_count = states) {
+    // written to a temporary file first and renamed, so other processes never map a half written table
+
+    table_header h = make_table_header(layout, payload.data(), payload.size(), state_count);
+    string tmp_path = string(path) + ".tmp" + to_string(getpid());
+    {
+        ofstream table_file(tmp_path, ios::binary);
+        table_file.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        table_file.write(reinterpret_cast<const char *>(payload.data()), payload.size());
+        if (!table_file) return false;
+    }
+    error_code ec;
+    filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+template <typename builder_t>
+bool load_table(mapped_table &table, const string &path, uint32_t layout, uint64_t payload_size, builder_t build,
+                string &error, uint32_t state_count = states, bool check_payload = true) {
+    // maps the table at path, (re)building it with build(payload) first if it is missing or unusable
+    // check_payload = checksum the payload too (a pass over the file, the graph checks its own in the background)
+    // returns false with the reason if even the rebuilt table can't be written and mapped
+
+    if (table.open(path.c_str(), layout, payload_size, error, state_count) && (!check_payload || table.verify(error))) {
+        return true;
+    }
+    if (status_log && error != "missing") *status_log << path << " can't be used (" << error << "), rebuilding\n";
+
+    vector<uint8_t> payload(payload_size);
+    build(payload);
+    bool written = write_table(path.c_str(), layout, payload, state_count);
+    if (!written) error = strerror(errno);
+    else written = table.open(path.c_str(), layout, payload_size, error, state_count);
+    if (written && !table.checksum_ok()) {
+        // read back once, so a bad write is caught here rather than on the next start
+        error = "checksum mismatch";
+        table.close();
+        written = false;
+    }
+    if (!written) error = "could not write " + path + " (" + error + ")";
+    return written;
+}
+
+struct graph_node {
+    int32_t depth;
+    array<int32_t, 9> adj;
+};
+
+inline void make_graph(vector<uint8_t> &payload) {
+    /*
+     *  Graph is an array of nodes, one per state
+     *  depth -> depth from solved state
+     *  adj -> adjacency list
+     *  Adjacency list contains list of hashes of all cubes one turn away from the current cube state
+     *  Index of array = hash of current cube state
+     *
+     *  initial depth = 20
+     *  initial adj list = {-1 x9}
+     *
+     *
+     */
+
+    vector<int> compliment = {2, 1, 0, 5, 4, 3, 8, 7, 6};
+    /* Stores the move compliment of a given move, from the cube header file
+     *
+     * for eg. move 0 = D, move 2 = D'
+     * if state 1 becomes state 2 upon performing D, then state 2 becomes 1 upon performing D'
+     * i.e compliment of D is D'
+     * => compliment of 0 is 2
+     * which is what this vector is for
+     * helps us fill the graph quicker
+     *
+     */
+
+    graph_node *graph = reinterpret_cast<graph_node *>(payload.data());
+    for (int i = 0; i < states; i++) graph[i] = { 20, {-1, -1, -1, -1, -1, -1, -1, -1, -1} };
+
+    auto start_time = chrono::high_resolution_clock::now();
+    const move_tables &mt = get_move_tables();
+    auto tables_time = chrono::high_resolution_clock::now();
+    if (status_log) {
+        *status_log << "Move tables built in "
+                    << chrono::duration_cast<chrono::milliseconds>(tables_time - start_time).count() << " milliseconds\n";
+    }
+    graph[0].depth = 0;
+    int ctr = 0;
+    queue<int> next;
+    next.push(0);
+    while (!next.empty()) {
+        int cur = next.front();
+        next.pop();
+        if (status_log && ctr % 100000 == 0) *status_log << ctr << ":" << endl;
+        for (int j = 0; j < 9; j++) {
+            if(graph[cur].adj[j] == -1) {
+                int adj = mt.neighbour(cur, j);
+                graph[cur].adj[j] = adj;
+
+                if(graph[adj].depth == 20) {
+                    graph[adj].depth = graph[cur].depth + 1;
+                    next.push(adj);
+                }
+
+                graph[adj].adj[compliment[j]] = cur;
+            }
+        }
+        ctr++;
+    }
+    print_bfs_time(tables_time, 1);
+}
+
+
+
+template <int count>
+struct packed_depths {
+    /*
+     * Compact alternative to the adjacency graph
+     *
+     * solution() only ever compares the depth of a cube with the depth of its neighbours,
+     * and neighbours always differ in depth by -1, 0 or +1
+     * so depth mod 3 is enough to tell which neighbour is one move closer to solved
+     *
+     * 2 bits per state, 4 states per byte => ~0.9 MB instead of ~147 MB for the graph
+     * 0, 1, 2 = depth mod 3
+     * 3 = not visited yet (only while building)
+     *
+     * Neighbours are not stored, they are recomputed from the move tables when needed
+     *
+     * count is the number of states of the puzzle, see puzzle_engine for the other move sets
+     */
+
+    static constexpr size_t bytes = (count + 3) / 4;
+
+    const uint8_t *bits = nullptr;
+
+    int get(int hash) const {
+        return get(bits, hash);
+    }
+
+    static int get(const uint8_t *bits, int hash) {
+        return (bits[hash >> 2] >> ((hash & 3) << 1)) & 3;
+    }
+
+    static void set(uint8_t *bits, int hash, int depth_mod3) {
+        int shift = (hash & 3) << 1;
+        bits[hash >> 2] = (bits[hash >> 2] & ~(3 << shift)) | (depth_mod3 << shift);
+    }
+};
+
+using depth_table = packed_depths<states>;
+
+inline void make_table(vector<uint8_t> &payload) {
+    // Same BFS as make_graph, but only the depth (mod 3) of each state is kept
+
+    uint8_t *bits = payload.data();
+    fill(payload.begin(), payload.end(), 0xFF);
+
+    auto start_time = chrono::high_resolution_clock::now();
+    const move_tables &mt = get_move_tables();
+    auto tables_time = chrono::high_resolution_clock::now();
+    if (status_log) {
+        *status_log << "Move tables built in "
+                    << chrono::duration_cast<chrono::milliseconds>(tables_time - start_time).count() << " milliseconds\n";
+    }
+    depth_table::set(bits, 0, 0);
+    int ctr = 0;
+    queue<int> next;
+    next.push(0);
+    while (!next.empty()) {
+        int cur = next.front();
+        next.pop();
+        if (status_log && ctr % 100000 == 0) *status_log << ctr << ":" << endl;
+        for (int j = 0; j < 9; j++) {
+            int adj = mt.neighbour(cur, j);
+            if (depth_table::get(bits, adj) == 3) {
+                depth_table::set(bits, adj, (depth_table::get(bits, cur) + 1) % 3);
+                next.push(adj);
+            }
+        }
+        ctr++;
+    }
+    print_bfs_time(tables_time, 1);
+}
+
+template <typename fn_t>
+void parallel_for(int threads, int chunks, fn_t fn) {
+    // runs fn(chunk) for every chunk in [0, chunks), threads grab the next unclaimed chunk until none are left
+
+    atomic<int> next_chunk(0);
+    auto worker = [&]() {
+        for (int c; (c = next_chunk.fetch_add(1, memory_order_relaxed)) < chunks;) fn(c);
+    };
+    if (threads <= 1) {
+        worker();
+        return;
+    }
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++) pool.emplace_back(worker);
+    for (auto &t : pool) t.join();
+}
+
+template <typename puzzle_t, typename claim_t, typename layer_t>
+void parallel_bfs(const puzzle_t &puzzle, int threads, claim_t claim, layer_t layer_done) {
+    /*
+     * Level synchronous BFS from the solved state
+     *
+     * The frontier is a bit per state; for depth d every thread takes chunks of the current frontier,
+     * and claim(adj, d + 1) has to atomically mark adj as visited and return true only for the one thread that did it
+     * Claimed states are OR'd into the next frontier, then the two are swapped
+     *
+     * Depths only depend on the BFS layer, not on the order states were expanded in,
+     * so the result is the same as the serial BFS for any number of threads
+     *
+     * layer_done(d, n) is called once all n states at depth d have been claimed (before the next layer starts)
+     *
+     * puzzle is the move set (move_tables for R/F/D, or a corner_subgroup), state 0 is solved
+     */
+
+    const int words = (puzzle_t::state_count + 63) / 64;
+    const int words_per_chunk = 256;
+    const int chunks = (words + words_per_chunk - 1) / words_per_chunk;
+    vector<uint64_t> frontier(words, 0), next(words, 0);
+    frontier[0] = 1;
+
+    for (int depth = 0;; depth++) {
+        atomic<int> found(0);
+        parallel_for(threads, chunks, [&](int chunk) {
+            int count = 0;
+            int end = min(words, (chunk + 1) * words_per_chunk);
+            for (int w = chunk * words_per_chunk; w < end; w++) {
+                for (uint64_t bits = frontier[w]; bits; bits &= bits - 1) {
+                    int cur = w * 64 + __builtin_ctzll(bits);
+                    for (int j = 0; j < puzzle_t::move_count; j++) {
+                        int adj = puzzle.neighbour(cur, j);
+                        if (claim(adj, depth + 1)) {
+                            __atomic_fetch_or(&next[adj >> 6], 1ULL << (adj & 63), __ATOMIC_RELAXED);
+                            count++;
+                        }
+                    }
+                }
+            }
+            found += count;
+        });
+
+        if (found == 0) break;
+        layer_done(depth + 1, found.load());
+        swap(frontier, next);
+        fill(next.begin(), next.end(), 0);
+    }
+}
+
+template <typename claim_t, typename layer_t>
+void parallel_bfs(int threads, claim_t claim, layer_t layer_done) {
+    parallel_bfs(get_move_tables(), threads, claim, layer_done);
+}
+
+inline void print_layer(int depth, int found) {
+    if (status_log) *status_log << "depth " << depth << ": " << found << " states" << endl;
+}
+
+template <typename claim_t>
+void parallel_bfs(int threads, claim_t claim) {
+    parallel_bfs(threads, claim, print_layer);
+}
+
+inline void make_graph_parallel(vector<uint8_t> &payload, int threads) {
+    // Parallel version of make_graph, produces the exact same bytes
+
+    graph_node *graph = reinterpret_cast<graph_node *>(payload.data());
+    const move_tables &mt = get_move_tables();
+    auto start_time = chrono::high_resolution_clock::now();
+    const int chunk_size = 16384;
+    const int chunks = (states + chunk_size - 1) / chunk_size;
+
+    parallel_for(threads, chunks, [&](int chunk) {
+        int end = min(states, (chunk + 1) * chunk_size);
+        for (int i = chunk * chunk_size; i < end; i++) {
+            graph[i].depth = 20;
+            // every adjacency list ends up as the state's own neighbours, no need for the compliment trick here
+            for (int j = 0; j < 9; j++) graph[i].adj[j] = mt.neighbour(i, j);
+        }
+    });
+    graph[0].depth = 0;
+
+    parallel_bfs(threads, [graph](int adj, int depth) {
+        int32_t unvisited = 20;
+        return __atomic_compare_exchange_n(&graph[adj].depth, &unvisited, depth, false,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    });
+    print_bfs_time(start_time, threads);
+}
+
+inline bool claim_depth(uint8_t *bits, int hash, int depth) {
+    // 4 states share a byte, so the byte is compare-and-swapped until either we wrote our 2 bits
+    // or someone else already visited this state
+    int shift = (hash & 3) << 1;
+    uint8_t old = __atomic_load_n(&bits[hash >> 2], __ATOMIC_RELAXED);
+    do {
+        if (((old >> shift) & 3) != 3) return false;
+    } while (!__atomic_compare_exchange_n(&bits[hash >> 2], &old, (uint8_t) (old & ~((3 ^ (depth % 3)) << shift)),
+                                          true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return true;
+}
+
+inline void make_table_parallel(vector<uint8_t> &payload, int threads) {
+    // Parallel version of make_table, produces the exact same bytes
+
+    uint8_t *bits = payload.data();
+    fill(payload.begin(), payload.end(), 0xFF);
+    depth_table::set(bits, 0, 0);
+    get_move_tables();
+    auto start_time = chrono::high_resolution_clock::now();
+
+    parallel_bfs(threads, [bits](int adj, int depth) { return claim_depth(bits, adj, depth); });
+    print_bfs_time(start_time, threads);
+}
+
+const int max_moves = 11;
+// Longest optimal solution (God's number for the 2x2 in the half turn metric)
+
+using move_buffer = array<uint8_t, max_moves>;
+// Solutions are returned as move indices into one of these, so solving never allocates
+
+const array<string, 18> move_names = {"F", "F2", "F'", "D", "D2", "D'", "R", "R2", "R'",
+                                      "L", "L2", "L'", "B", "B2", "B'", "U", "U2", "U'"};
+// Same numbering as cube::apply_move, the solving moves are the first 9
+
+template <typename puzzle_t, typename table_t, typename emit_t>
+int walk_solution(const puzzle_t &puzzle, int hash, const table_t &table, emit_t emit, int max_length = max_moves) {
+    /*
+     * Same idea as the graph version, except the neighbours are generated on the fly from the move tables
+     * and we look for the neighbour whose depth is (depth - 1) mod 3
+     * (works for any table with get(hash) = depth mod 3, i.e. depth_table and sym_depth_table)
+     *
+     * hash 0 is the only state with depth 0, so that is where we stop
+     * emit(move) is called for every move of the solution, returns the number of moves
+     *
+     * On a real table every step finds a neighbour and the walk is at most God's number long,
+     * so -1 (stuck, or more than max_length moves) means the table is corrupt or isn't this puzzle's
+     */
+
+    int length = 0;
+    while (hash != 0) {
+        if (length == max_length) return -1;
+        int target = (table.get(hash) + 2) % 3, next = -1;
+        for (int i = 0; i < puzzle_t::move_count; i++) {
+            int adj = puzzle.neighbour(hash, i);
+            if (table.get(adj) == target) {
+                emit(i);
+                next = adj;
+                break;
+            }
+        }
+        if (next < 0) return -1;
+        hash = next;
+        length++;
+    }
+    return length;
+}
+
+template <typename table_t>
+int solution(int hash, const table_t &table, uint8_t *moves) {
+    // returns the number of moves written, -1 if the table has no solution for hash (see walk_solution)
+    int length = 0;
+    return walk_solution(get_move_tables(), hash, table, [&](int move) { moves[length++] = move; });
+}
+
+inline int solution(int hash, const graph_node *graph, uint8_t *moves) {
+    /*
+     * Uses a bit of a property of the way the graph was generated
+     *
+     * move 0 = F, so the 0th element of the adjacency list is (old cube + F)
+     * similary, 1 = F2 and so on
+     *
+     * so we find the first element with a depth lower than the current cube, 
+     *  and add the corresponding move to the solution.
+     *  (at max 11 steps of O(1) operations so doesn't take long at all)
+     *
+     * if depth of cube = 0, cube is solved, we are done
+     * -1 if no neighbour is closer or the walk gets longer than max_moves (a corrupt graph)
+     */
+
+    int length = 0;
+    while (graph[hash].depth != 0) {
+        if (length == max_moves) return -1;
+        int next = -1;
+        for (int i = 0; i < 9; i++) { 
+            if (graph[graph[hash].adj[i]].depth == graph[hash].depth - 1) {
+                moves[length++] = i;
+                next = graph[hash].adj[i];
+                break;
+            }
+        }
+        if (next < 0) return -1;
+        hash = next;
+    }
+    return length;
+}
+
+inline string format_moves(const uint8_t *moves, int length) {
+    // optional text form of a solution, e.g. "R U2 F'"
+    string text;
+    for (int i = 0; i < length; i++) {
+        if (i) text += ' ';
+        text += move_names[moves[i]];
+    }
+    return text;
+}
+
+/*
+ * Interleaved solving
+ *
+ * Every step of solution() waits on the table: the depths of the neighbours decide the next state,
+ * whose neighbours are the next reads. One solve at a time, that's a chain of cache misses (a DRAM round trip
+ * per move for the 147 MB graph), with the core idle in between
+ *
+ * So many independent solves are walked in lockstep instead: each one has its next reads prefetched
+ * as soon as it knows them, then the other lanes get their turn, and by the time it comes round again
+ * the data is (hopefully) in cache. The misses of all the lanes overlap instead of queueing up
+ *
+ * A walker says how a solve starts (prefetching its first reads) and how it takes a step
+ * (returning the move, -1 if that turn only issued prefetches, or walk_failed if no neighbour is closer),
+ * the driver keeps the lanes full
+ * Moves come out exactly the same as solution(), including length -1 for a walk that fails or passes max_moves
+ */
+
+const int max_lanes = 64;
+const int walk_failed = -2;
+
+template <typename walker_t>
+void interleaved_solutions(const walker_t &walker, const int *hashes, int count, move_buffer *moves, int *lengths,
+                           int lanes) {
+    array<typename walker_t::state, max_lanes> lane;
+    array<int, max_lanes> index;
+    lanes = max(1, min(lanes, max_lanes));
+    int next = 0;
+
+    auto refill = [&](int l) {
+        // next unsolved hash into lane l, false when there are none left
+        while (next < count) {
+            int i = next++;
+            lengths[i] = 0;
+            if (hashes[i] == 0) continue;
+            index[l] = i;
+            walker.start(lane[l], hashes[i]);
+            return true;
+        }
+        return false;
+    };
+
+    int active = 0;
+    while (active < lanes && refill(active)) active++;
+    while (active) {
+        for (int l = 0; l < active;) {
+            int i = index[l];
+            int move = walker.step(lane[l]);
+            if (move >= 0 && lengths[i] == max_moves) move = walk_failed;
+            if (move >= 0) moves[i][lengths[i]++] = move;
+            if (move == walk_failed) lengths[i] = -1; // the lane ends here, failed
+            if ((move == walk_failed || walker.done(lane[l])) && !refill(l)) {
+                // nothing left to start, the last lane takes this one's place
+                active--;
+                lane[l] = lane[active];
+                index[l] = index[active];
+                continue;
+            }
+            l++;
+        }
+    }
+}
+
+struct depth_walker {
+    // solution() over a depth table: neighbours from the move tables, their 2 bit depths prefetched
+    const depth_table &table;
+    const move_tables &mt = get_move_tables();
+
+    struct state {
+        int hash;
+        int target; // depth mod 3 of the next state, -1 until the state's own depth has been read
+        array<int, 9> adj;
+    };
+
+    void expand(state &s) const {
+        for (int i = 0; i < 9; i++) {
+            s.adj[i] = mt.neighbour(s.hash, i);
+            __builtin_prefetch(table.bits + (s.adj[i] >> 2));
+        }
+    }
+
+    void start(state &s, int hash) const {
+        s.hash = hash;
+        s.target = -1;
+        __builtin_prefetch(table.bits + (hash >> 2));
+        expand(s);
+    }
+
+    int step(state &s) const {
+        if (s.target < 0) s.target = (table.get(s.hash) + 2) % 3;
+        for (int i = 0; i < 9; i++) {
+            if (table.get(s.adj[i]) == s.target) {
+                s.hash = s.adj[i];
+                s.target = (s.target + 2) % 3;
+                if (s.hash) expand(s);
+                return i;
+            }
+        }
+        return walk_failed;
+    }
+
+    bool done(const state &s) const {
+        return s.hash == 0;
+    }
+};
+
+struct graph_walker {
+    /*
+     * solution() over the graph, a node is 40 bytes:
+     *      neighbours only need their depth, which is always in the node's first cache line
+     *      the node that gets moved to also needs its adjacency list, which can spill into the next line
+     *      (then that line is prefetched and read on the lane's next turn)
+     */
+    const graph_node *graph;
+
+    struct state {
+        int hash;
+        bool expanded; // depths of hash's neighbours prefetched
+    };
+
+    bool straddles(int hash) const {
+        return ((uintptr_t) &graph[hash] & 63) + sizeof(graph_node) > 64;
+    }
+
+    void expand(state &s) const {
+        for (int i = 0; i < 9; i++) __builtin_prefetch(&graph[graph[s.hash].adj[i]]);
+        s.expanded = true;
+    }
+
+    void move_to(state &s, int hash) const {
+        // the node's first line is in cache (or on its way), expanded on this turn if that's all it needs
+        s.hash = hash;
+        s.expanded = false;
+        if (straddles(hash)) __builtin_prefetch(&graph[hash].adj[8]);
+        else if (hash) expand(s);
+    }
+
+    void start(state &s, int hash) const {
+        // nothing of the node is in cache yet, so only its lines are prefetched, it is expanded on the lane's next turn
+        s.hash = hash;
+        s.expanded = false;
+        __builtin_prefetch(&graph[hash]);
+        if (straddles(hash)) __builtin_prefetch(&graph[hash].adj[8]);
+    }
+
+    int step(state &s) const {
+        if (!s.expanded) {
+            expand(s);
+            return -1;
+        }
+        int depth = graph[s.hash].depth;
+        for (int i = 0; i < 9; i++) {
+            int adj = graph[s.hash].adj[i];
+            if (graph[adj].depth == depth - 1) {
+                move_to(s, adj);
+                return i;
+            }
+        }
+        return walk_failed;
+    }
+
+    bool done(const state &s) const {
+        return s.hash == 0;
+    }
+};
+
+
+/*
+ * All optimal solutions
+ *
+ * A move is part of some optimal solution exactly when it goes one layer closer to solved,
+ * so the optimal solutions of a state are all the paths down the depth table's descending edges
+ *
+ * count_optimal_solutions counts them without building any (number of paths, memoized per hash)
+ * enumerate_optimal_solutions writes them into a solution_arena, as rows of move indices (0 - 8)
+ */
+
+inline uint64_t count_optimal_solutions(int hash, const depth_table &table, unordered_map<int, uint64_t> &memo) {
+    if (hash == 0) return 1;
+    auto it = memo.find(hash);
+    if (it != memo.end()) return it->second;
+
+    int target = (table.get(hash) + 2) % 3;
+    const move_tables &mt = get_move_tables();
+    uint64_t total = 0;
+    for (int i = 0; i < 9; i++) {
+        int adj = mt.neighbour(hash, i);
+        if (table.get(adj) == target) total += count_optimal_solutions(adj, table, memo);
+    }
+    memo[hash] = total;
+    return total;
+}
+
+struct solution_arena {
+    // every optimal solution of a state has the same length, so they're stored back to back, length moves each
+
+    int length = 0;
+    size_t count = 0;
+    vector<uint8_t> moves;
+
+    const uint8_t *operator[](size_t i) const {
+        return moves.data() + i * length;
+    }
+};
+
+inline bool walk_optimal_solutions(int hash, const depth_table &table, solution_arena &arena, size_t limit,
+                            array<uint8_t, 16> &path, int step) {
+    // depth first over the descending edges, returns true once limit solutions have been stored
+    if (hash == 0) {
+        arena.moves.insert(arena.moves.end(), path.begin(), path.begin() + step);
+        arena.count++;
+        return limit != 0 && arena.count >= limit;
+    }
+
+    int target = (table.get(hash) + 2) % 3;
+    const move_tables &mt = get_move_tables();
+    for (int i = 0; i < 9; i++) {
+        int adj = mt.neighbour(hash, i);
+        if (table.get(adj) != target) continue;
+        path[step] = i;
+        if (walk_optimal_solutions(adj, table, arena, limit, path, step + 1)) return true;
+    }
+    return false;
+}
+
+inline void enumerate_optimal_solutions(int hash, const depth_table &table, solution_arena &arena, size_t limit) {
+    // stores up to limit optimal solutions of hash (all of them if limit = 0) in arena, in move order
+
+    arena.moves.clear();
+    arena.count = 0;
+    array<uint8_t, 16> path;
+    walk_optimal_solutions(hash, table, arena, limit, path, 0);
+    arena.length = arena.count ? arena.moves.size() / arena.count : 0;
+}
+
+inline vector<uint32_t> all_optimal_counts(const depth_table &table, int threads) {
+    /*
+     * Number of optimal solutions of every state, computed layer by layer outward from solved:
+     * count[h] = sum of count[adj] over the neighbours one layer closer
+     * Each layer only reads the one before it, so every layer is split across the threads
+     */
+
+    const move_tables &mt = get_move_tables();
+    vector<uint32_t> counts(states, 0);
+    counts[0] = 1;
+    vector<int> layer = {0}, next;
+    const int chunk_size = 4096;
+
+    for (int depth = 0; !layer.empty(); depth++) {
+        // states of the next layer are the unseen neighbours with depth + 1 (mod 3)
+        int target = (depth + 1) % 3;
+        next.clear();
+        for (int h : layer) {
+            for (int i = 0; i < 9; i++) {
+                int adj = mt.neighbour(h, i);
+                if (table.get(adj) == target && counts[adj] == 0) {
+                    counts[adj] = UINT32_MAX; // seen, filled in below
+                    next.push_back(adj);
+                }
+            }
+        }
+
+        int down = depth % 3;
+        int n = next.size();
+        parallel_for(threads, (n + chunk_size - 1) / chunk_size, [&](int chunk) {
+            int end = min(n, (chunk + 1) * chunk_size);
+            for (int k = chunk * chunk_size; k < end; k++) {
+                int h = next[k];
+                uint32_t total = 0;
+                for (int i = 0; i < 9; i++) {
+                    int adj = mt.neighbour(h, i);
+                    if (table.get(adj) == down) total += counts[adj];
+                }
+                counts[h] = total;
+            }
+        });
+        swap(layer, next);
+    }
+    return counts;
+}
+
+inline bool open_graph(mapped_table &table_file, const string &path, int threads, bool check_payload, string &error) {
+    return load_table(table_file, path, LAYOUT_GRAPH, (uint64_t) states * sizeof(graph_node),
+                      [threads](vector<uint8_t> &payload) {
+                          if (threads == 1) make_graph(payload);
+                          else make_graph_parallel(payload, threads);
+                      }, error, states, check_payload);
+}
+
+inline bool open_depth_table(mapped_table &table_file, const string &path, int threads, string &error) {
+    return load_table(table_file, path, LAYOUT_DEPTH2, depth_table::bytes,
+                      [threads](vector<uint8_t> &payload) {
+                          if (threads == 1) make_table(payload);
+                          else make_table_parallel(payload, threads);
+                      }, error);
+}
+
+
+/*
+ * Progressive depth table
+ *
+ * On a cold start (no depth.bin and nothing compiled in) the BFS runs on a background thread
+ * and queries are answered while it goes:
+ *      a state the BFS has reached already is walked down as usual (every layer below it is finished)
+ *      otherwise a short search (up to bridge_moves deep) looks for reached states and goes through the best one
+ *      if that finds nothing the query waits for the next layer and tries again
+ *
+ * The first layers take microseconds and depth <= 7 (8% of states) is done long before the big layers,
+ * so with the 4 move bridge every query gets answered almost as soon as the build starts
+ *
+ * The table is built straight into a shared mapping of the temporary file (flushed after every layer),
+ * then the header goes in and it is renamed to depth.bin, same as write_table
+ */
+
+struct live_depth_table {
+    // depth_table reads that are safe while the BFS is still writing other states in the same byte
+    const uint8_t *bits;
+
+    int get(int hash) const {
+        return (__atomic_load_n(&bits[hash >> 2], __ATOMIC_RELAXED) >> ((hash & 3) << 1)) & 3;
+    }
+};
+
+class progressive_table {
+    public:
+        static constexpr int bridge_moves = 4;
+
+        progressive_table() = default;
+        progressive_table(const progressive_table &) = delete;
+        progressive_table &operator=(const progressive_table &) = delete;
+
+        ~progressive_table() {
+            if (builder.joinable()) builder.join();
+            if (base) munmap(base, length);
+        }
+
+        bool start(const char *path, int threads) {
+            // starts the background build, returns false if there isn't even memory for the table
+            length = sizeof(table_header) + depth_table::bytes;
+            temp_path = string(path) + ".tmp" + to_string(getpid());
+            int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            void *mapping = MAP_FAILED;
+            if (fd >= 0 && ftruncate(fd, length) == 0) mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (fd >= 0) ::close(fd);
+            if (mapping == MAP_FAILED) {
+                if (status_log) *status_log << "could not write " << temp_path << ", the table will only be kept in memory\n";
+                unlink(temp_path.c_str());
+                temp_path.clear();
+                mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (mapping == MAP_FAILED) return false;
+            }
+            base = static_cast<uint8_t *>(mapping);
+            bits = base + sizeof(table_header);
+            memset(bits, 0xFF, depth_table::bytes);
+            depth_table::set(bits, 0, 0);
+            builder = thread(&progressive_table::build, this, string(path), threads);
+            return true;
+        }
+
+        const uint8_t *data() const {
+            return bits;
+        }
+
+        bool complete() const {
+            return finished.load(memory_order_acquire);
+        }
+
+        void wait() const {
+            unique_lock<mutex> lock(layer_mutex);
+            layer_ready.wait(lock, [this] { return complete(); });
+        }
+
+        int solution(int hash, uint8_t *moves) const {
+            // same result as ::solution on the finished table, returns the number of moves
+            if (complete()) return ::solution(hash, depth_table{bits}, moves);
+            live_depth_table live{bits};
+            while (true) {
+                int layers = done_layers.load(memory_order_acquire);
+                if (live.get(hash) != 3) return ::solution(hash, live, moves);
+                int length = bridge(hash, layers + 1, moves);
+                if (length >= 0) return length;
+
+                unique_lock<mutex> lock(layer_mutex);
+                layer_ready.wait(lock, [&] { return complete() || done_layers.load(memory_order_acquire) > layers; });
+                if (complete()) return ::solution(hash, depth_table{bits}, moves);
+            }
+        }
+
+    private:
+        uint8_t *base = nullptr;
+        uint8_t *bits = nullptr;
+        size_t length = 0;
+        string temp_path;
+        thread builder;
+        atomic<int> done_layers{0};
+        atomic<bool> finished{false};
+        mutable mutex layer_mutex;
+        mutable condition_variable layer_ready;
+
+        void build(string path, int threads) {
+            // signals stay with the threads that wait for them (serve's sigwait)
+            sigset_t all;
+            sigfillset(&all);
+            pthread_sigmask(SIG_BLOCK, &all, nullptr);
+
+            auto start_time = chrono::high_resolution_clock::now();
+            uint8_t *table = bits;
+            parallel_bfs(threads, [table](int adj, int depth) { return claim_depth(table, adj, depth); },
+                         [this](int depth, int) {
+                             if (!temp_path.empty()) msync(base, length, MS_ASYNC);
+                             {
+                                 lock_guard<mutex> lock(layer_mutex);
+                                 done_layers.store(depth, memory_order_release);
+                             }
+                             layer_ready.notify_all();
+                         });
+
+            if (!temp_path.empty()) {
+                table_header h = make_table_header(LAYOUT_DEPTH2, bits, depth_table::bytes);
+                memcpy(base, &h, sizeof(h));
+                error_code ec;
+                if (msync(base, length, MS_SYNC) == 0) filesystem::rename(temp_path, path, ec);
+                else ec = make_error_code(errc::io_error);
+                if (ec) {
+                    if (status_log) *status_log << "could not write " << path << ", the table will only be kept in memory\n";
+                    unlink(temp_path.c_str());
+                }
+            }
+            {
+                lock_guard<mutex> lock(layer_mutex);
+                finished.store(true, memory_order_release);
+            }
+            layer_ready.notify_all();
+            auto end_time = chrono::high_resolution_clock::now();
+            if (status_log) {
+                *status_log << "Table construction complete in "
+                            << chrono::duration_cast<chrono::milliseconds>(end_time - start_time).count()
+                            << " milliseconds (in the background, " << done_layers.load() << " layers)" << endl;
+            }
+        }
+
+        int bridge(int hash, int max_depth, uint8_t *moves) const {
+            /*
+             * Iterative deepening from hash until some state k moves away has been reached by the BFS
+             * Every state k moves away is at least (depth - k) deep, so among the ones found at the first such k
+             * the one with the shortest walk gives an optimal solution
+             * (only walks up to max_depth count: deeper states could be from a layer that finished mid search)
+             * returns -1 if nothing is found within bridge_moves
+             */
+
+            const move_tables &mt = get_move_tables();
+            live_depth_table live{bits};
+            array<uint8_t, bridge_moves> path, best_path;
+            int best_walk = max_depth + 1, best_end = -1;
+            move_buffer walk;
+
+            auto search = [&](auto &&self, int cur, int done, int k, int last_face) -> void {
+                if (done == k) {
+                    if (live.get(cur) == 3) return;
+                    int w = ::solution(cur, live, walk.data());
+                    if (w >= 0 && w < best_walk) {
+                        best_walk = w;
+                        best_end = cur;
+                        best_path = path;
+                    }
+                    return;
+                }
+                for (int m = 0; m < 9; m++) {
+                    if (m / 3 == last_face) continue;
+                    path[done] = m;
+                    self(self, mt.neighbour(cur, m), done + 1, k, m / 3);
+                }
+            };
+
+            for (int k = 1; k <= bridge_moves; k++) {
+                search(search, hash, 0, k, -1);
+                if (best_end < 0) continue;
+                copy(best_path.begin(), best_path.begin() + k, moves);
+                int rest = ::solution(best_end, live, moves + k);
+                return rest < 0 ? -1 : k + rest;
+            }
+            return -1;
+        }
+};
+
+/*
+ * Other move sets
+ *
+ * Tables and solving only need a puzzle description:
+ *      state_count, move_count     compile time constants, every table is sized from them
+ *      neighbour(state, move)      state 0 is solved
+ *      cube_move(move)             the cube::apply_move index of a move (for names)
+ *      inverse(move)               the move that undoes it (for scrambles)
+ * move_tables is the description of the R/F/D cube, corner_subgroup builds one for another set of faces
+ * and puzzle_engine is the depth table + solving for any of them, with the same BFS and walk as the depth engine
+ */
+
+enum : uint32_t {
+    LAYOUT_SUBGROUP = 4 // 2 bit depth mod 3 per corner_subgroup state, the subgroup's face mask is in bits 8 and up
+};
+
+template <int slots>
+constexpr int slot_lehmer(const array<uint8_t, 8> &arrangement) {
+    // same Lehmer code as cube_hash, over the first slots entries
+    unsigned unused = (1u << slots) - 1;
+    int code = 0;
+    for (int s = 0; s < slots; s++) {
+        unsigned bit = 1u << arrangement[s];
+        code += __builtin_popcount(unused & (bit - 1)) * factorials[slots - 1 - s];
+        unused &= ~bit;
+    }
+    return code;
+}
+
+template <int slots>
+constexpr array<uint8_t, 8> slot_unlehmer(int code) {
+    array<uint8_t, 8> arrangement{};
+    unsigned unused = (1u << slots) - 1;
+    for (int s = 0; s < slots; s++) {
+        int digit = code / factorials[slots - 1 - s];
+        code %= factorials[slots - 1 - s];
+        unsigned m = unused;
+        for (int k = 0; k < digit; k++) m &= m - 1;
+        arrangement[s] = __builtin_ctz(m);
+        unused &= ~(1u << arrangement[s]);
+    }
+    return arrangement;
+}
+
+template <int... faces>
+constexpr uint8_t subgroup_positions() {
+    // mask of the corner positions the faces move
+    uint8_t mask = 0;
+    for (int face : {faces...}) {
+        cube c = solved[0];
+        c.apply_move(3 * face);
+        for (int i = 0; i < 8; i++) {
+            if (c.pieces[i] != i) mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+template <int... faces>
+struct corner_subgroup {
+    /*
+     * The 2x2 turned with only some faces (cube::apply_move faces: 0 = F, 1 = D, 2 = R, 3 = L, 4 = B, 5 = U)
+     * Each face gives 3 moves (X, X2, X'), in the order the faces are listed
+     *
+     * Only the positions the faces move are tracked (slots), the other corners never leave home
+     *      perm = Lehmer code of which slot's piece is in each slot
+     *      twist = ternary orientation digits of all slots but the last (the last one makes the sum 0 mod 3)
+     *      state = perm * twist_count + twist
+     * As with move_tables, moves act on perm and twist separately, so a neighbour is 2 lookups
+     *
+     * state_count is slots! * 3^(slots - 1), which can be more than the faces reach:
+     *      <R, U>      6 slots, 174960 coordinates, 29160 reachable (only 120 of the 720 arrangements)
+     *      <R, U, F>   7 slots, 3674160 coordinates, all reachable
+     * The others are never visited by the BFS and stay 3 in the depth table (~44 KB wasted for <R, U>),
+     * in exchange every size is known at compile time and a coordinate is a plain Lehmer code
+     */
+
+    static constexpr array<int, sizeof...(faces)> face_list = {faces...};
+    static constexpr int move_count = 3 * sizeof...(faces);
+    static constexpr uint8_t positions = subgroup_positions<faces...>();
+    static constexpr int slots = __builtin_popcount(positions);
+    static_assert(slots >= 2 && slots <= 7, "at least one corner has to stay fixed");
+
+    static constexpr int perm_count = factorials[slots];
+    static constexpr int twist_count = pow3[slots - 1];
+    static constexpr int state_count = perm_count * twist_count;
+    static constexpr int max_moves = 32;
+    // bound on solution walks, above God's number of any of these (14 for <R, U>), puzzle_engine::build checks it
+
+    static constexpr uint32_t layout = LAYOUT_SUBGROUP | ((1u << faces) | ...) << 8;
+
+    static constexpr int cube_move(int move) {
+        return 3 * face_list[move / 3] + move % 3;
+    }
+
+    static constexpr int inverse(int move) {
+        return 3 * (move / 3) + 2 - move % 3;
+    }
+
+    static constexpr array<int8_t, 8> slot_positions() {
+        // position of each slot, then -1
+        array<int8_t, 8> list{};
+        for (int i = 0, s = 0; i < 8; i++) {
+            list[i] = -1;
+            if (positions >> i & 1) list[s++] = i;
+        }
+        return list;
+    }
+    static constexpr array<int8_t, 8> position_of = slot_positions();
+
+    static constexpr int slot_of(int position) {
+        return __builtin_popcount(positions & ((1u << position) - 1));
+    }
+
+    static constexpr array<uint8_t, 8> move_arrangement(const array<uint8_t, 8> &arrangement, int move) {
+        // arrangement[s] = home slot of the piece in slot s
+        cube c = solved[0];
+        for (int s = 0; s < slots; s++) c.pieces[position_of[s]] = position_of[arrangement[s]];
+        c.apply_move(cube_move(move));
+        array<uint8_t, 8> next{};
+        for (int s = 0; s < slots; s++) next[s] = slot_of(c.pieces[position_of[s]]);
+        return next;
+    }
+
+    array<array<uint16_t, move_count>, perm_count> perm_move;
+    array<array<uint16_t, move_count>, twist_count> twist_move;
+
+    corner_subgroup() {
+        for (int p = 0; p < perm_count; p++) {
+            array<uint8_t, 8> cur = slot_unlehmer<slots>(p);
+            for (int m = 0; m < move_count; m++) perm_move[p][m] = slot_lehmer<slots>(move_arrangement(cur, m));
+        }
+
+        for (int t = 0; t < twist_count; t++) {
+            cube cur = solved[0];
+            int sum = 0;
+            for (int s = 0, rest = t; s < slots - 1; s++) {
+                cur.orientations[position_of[s]] = rest / pow3[slots - 2 - s];
+                rest %= pow3[slots - 2 - s];
+                sum += cur.orientations[position_of[s]];
+            }
+            cur.orientations[position_of[slots - 1]] = (3 - sum % 3) % 3;
+            for (int m = 0; m < move_count; m++) {
+                cube c = cur;
+                c.apply_move(cube_move(m));
+                twist_move[t][m] = twist(c);
+            }
+        }
+    }
+
+    int neighbour(int state, int move) const {
+        return perm_move[state / twist_count][move] * twist_count + twist_move[state % twist_count][move];
+    }
+
+    static int twist(const cube &c) {
+        int t = 0;
+        for (int s = 0; s < slots - 1; s++) t = t * 3 + c.orientations[position_of[s]];
+        return t;
+    }
+
+    static int state(const cube &c) {
+        // state of c, -1 if a corner these faces don't move is out of place
+        // (the coordinates can still be unreachable, that is for the depth table to say)
+        for (int i = 0; i < 8; i++) {
+            if (!(positions >> i & 1) && (c.pieces[i] != i || c.orientations[i] != 0)) return -1;
+        }
+        array<uint8_t, 8> arrangement{};
+        for (int s = 0; s < slots; s++) arrangement[s] = slot_of(c.pieces[position_of[s]]);
+        return slot_lehmer<slots>(arrangement) * twist_count + twist(c);
+    }
+};
+
+template <typename puzzle_t>
+const puzzle_t &get_puzzle() {
+    static const puzzle_t puzzle;
+    return puzzle;
+}
+
+template <typename puzzle_t>
+class puzzle_engine {
+    /*
+     * Depth table (2 bits per state) and solving for a puzzle description
+     * puzzle_engine<move_tables> is the depth engine minus its extras (embedded table, progressive start)
+     */
+    public:
+        using table_t = packed_depths<puzzle_t::state_count>;
+
+        const puzzle_t &puzzle = get_puzzle<puzzle_t>();
+        mapped_table table_file;
+        table_t table;
+
+        bool load(const string &path, uint32_t layout, int threads, string &error) {
+            // false with the reason if the table can't be loaded or built
+            if (!load_table(table_file, path, layout, table_t::bytes,
+                            [&](vector<uint8_t> &payload) { build(payload, threads); }, error, puzzle_t::state_count)) {
+                return false;
+            }
+            table.bits = table_file.payload();
+            return true;
+        }
+
+        void build(vector<uint8_t> &payload, int threads) const {
+            uint8_t *bits = payload.data();
+            fill(payload.begin(), payload.end(), 0xFF);
+            table_t::set(bits, 0, 0);
+
+            int reached = 1, deepest = 0;
+            parallel_bfs(puzzle, threads, [bits](int adj, int depth) { return claim_depth(bits, adj, depth); },
+                         [&](int depth, int found) {
+                print_layer(depth, found);
+                reached += found;
+                deepest = depth;
+            });
+            if (deepest > puzzle_t::max_moves && status_log) {
+                *status_log << "states " << deepest << " moves deep, solutions past " << puzzle_t::max_moves
+                            << " will be reported as failed" << endl;
+            }
+            if (status_log) *status_log << reached << " of " << puzzle_t::state_count << " states reachable" << endl;
+        }
+
+        bool reachable(int state) const {
+            return state >= 0 && table.get(state) != 3;
+        }
+
+        bool solve(int state, vector<uint8_t> &moves) const {
+            // false if the walk gets stuck or passes puzzle_t::max_moves (a corrupt table)
+            moves.clear();
+            return walk_solution(puzzle, state, table, [&](int move) { moves.push_back(move); }, puzzle_t::max_moves) >= 0;
+        }
+
+        bool scramble(int state, vector<uint8_t> &moves) const {
+            // a sequence that reaches state from solved (its solution backwards, each move inverted)
+            if (!solve(state, moves)) return false;
+            reverse(moves.begin(), moves.end());
+            for (uint8_t &move : moves) move = puzzle_t::inverse(move);
+            return true;
+        }
+
+        static string move_text(const vector<uint8_t> &moves) {
+            string text;
+            for (uint8_t move : moves) {
+                if (!text.empty()) text += ' ';
+                text += move_names[puzzle_t::cube_move(move)];
+            }
+            return text;
+        }
+};
+
+using ru_puzzle = corner_subgroup<2, 5>;
+using ruf_puzzle = corner_subgroup<2, 5, 0>;
+
+/*
+ * Compressed depth table
+ *
+ * So the depth table can be compiled into the binary (./solver --embed-table writes depth_table_data.hpp)
+ * 5 states per symbol, as the base 3 digits of a number below 3^5 = 243 (3674160 = 5 * 734832, no padding)
+ * and the symbols Huffman coded: ~1.47 bits per state, ~665 KB against ~900 KB for the 2 bit table
+ *
+ * Codes are canonical (only the length of each symbol's code is stored) and at most 12 bits,
+ * so decoding is one lookup per symbol in a 2^12 entry table that stays in L1 (~5 ms for the whole table)
+ */
+
+const int table_symbols = 243;
+const int table_groups = states / 5;
+const int max_code_length = 12;
+
+struct compressed_table {
+    array<uint8_t, table_symbols> lengths; // code length of each symbol, 0 = never used
+    vector<uint8_t> stream;                // codes, most significant bit first
+};
+
+inline array<uint8_t, table_symbols> huffman_lengths(const array<uint64_t, table_symbols> &freq) {
+    // plain Huffman, then the lengths over max_code_length are folded back in (the JPEG way, see T.81 K.3)
+
+    array<int, max_code_length * 4> count = {};
+    vector<pair<uint64_t, int>> used; // (frequency, symbol)
+    for (int s = 0; s < table_symbols; s++) if (freq[s]) used.push_back({freq[s], s});
+
+    // tree as parent links: leaves are 0 - (n - 1), internal nodes after that
+    int n = used.size();
+    vector<int> parent(2 * n, -1);
+    priority_queue<pair<uint64_t, int>, vector<pair<uint64_t, int>>, greater<>> heap;
+    for (int i = 0; i < n; i++) heap.push({used[i].first, i});
+    for (int next = n; heap.size() > 1; next++) {
+        auto a = heap.top(); heap.pop();
+        auto b = heap.top(); heap.pop();
+        parent[a.second] = parent[b.second] = next;
+        heap.push({a.first + b.first, next});
+    }
+    for (int i = 0; i < n; i++) {
+        int length = 0;
+        for (int node = i; parent[node] != -1; node = parent[node]) length++;
+        count[min(max(length, 1), (int) count.size() - 1)]++;
+    }
+
+    for (int l = count.size() - 1; l > max_code_length; l--) {
+        while (count[l] > 0) {
+            // two codes of length l become one of length l - 1 and a longer code of some length j < l - 1 splits in two
+            int j = l - 2;
+            while (count[j] == 0) j--;
+            count[l] -= 2;
+            count[l - 1]++;
+            count[j + 1] += 2;
+            count[j]--;
+        }
+    }
+
+    // most frequent symbols get the shortest codes
+    sort(used.begin(), used.end(), [](auto &a, auto &b) { return a.first > b.first; });
+    array<uint8_t, table_symbols> lengths = {};
+    int l = 1;
+    for (auto &u : used) {
+        while (count[l] == 0) l++;
+        lengths[u.second] = l;
+        count[l]--;
+    }
+    return lengths;
+}
+
+inline array<uint16_t, table_symbols> canonical_codes(const array<uint8_t, table_symbols> &lengths) {
+    // shorter codes first, same length in symbol order, each code is the previous one + 1
+    array<uint16_t, table_symbols> codes = {};
+    uint16_t code = 0;
+    for (int l = 1; l <= max_code_length; l++) {
+        for (int s = 0; s < table_symbols; s++) if (lengths[s] == l) codes[s] = code++;
+        code <<= 1;
+    }
+    return codes;
+}
+
+inline int table_symbol(const uint8_t *bits, int group) {
+    int symbol = 0;
+    for (int k = 4; k >= 0; k--) symbol = symbol * 3 + depth_table::get(bits, 5 * group + k);
+    return symbol;
+}
+
+inline compressed_table compress_depth_table(const uint8_t *bits) {
+    array<uint64_t, table_symbols> freq = {};
+    for (int g = 0; g < table_groups; g++) freq[table_symbol(bits, g)]++;
+
+    compressed_table ct;
+    ct.lengths = huffman_lengths(freq);
+    array<uint16_t, table_symbols> codes = canonical_codes(ct.lengths);
+
+    uint64_t buffer = 0;
+    int have = 0;
+    for (int g = 0; g < table_groups; g++) {
+        int s = table_symbol(bits, g);
+        buffer = (buffer << ct.lengths[s]) | codes[s];
+        have += ct.lengths[s];
+        while (have >= 8) {
+            have -= 8;
+            ct.stream.push_back(buffer >> have);
+        }
+    }
+    if (have) ct.stream.push_back(buffer << (8 - have));
+    return ct;
+}
+
+inline bool decompress_depth_table(const uint8_t *lengths, const uint8_t *stream, size_t stream_size, uint8_t *bits) {
+    // bits = depth_table::bytes bytes of 2 bit depths, false if the stream is cut short
+
+    array<uint8_t, table_symbols> length_array;
+    copy(lengths, lengths + table_symbols, length_array.begin());
+    array<uint16_t, table_symbols> codes = canonical_codes(length_array);
+
+    // every 12 bit window that starts with a code maps to that code's symbol and length
+    vector<uint16_t> lookup(1 << max_code_length);
+    for (int s = 0; s < table_symbols; s++) {
+        int l = lengths[s];
+        if (l == 0) continue;
+        int first = codes[s] << (max_code_length - l);
+        for (int i = 0; i < 1 << (max_code_length - l); i++) lookup[first + i] = s | l << 8;
+    }
+
+    // the 2 bit form of each symbol's 5 states, then placed at any bit offset with one shift
+    array<uint16_t, table_symbols> packed;
+    for (int s = 0; s < table_symbols; s++) {
+        packed[s] = 0;
+        for (int k = 0, v = s; k < 5; k++, v /= 3) packed[s] |= (v % 3) << (2 * k);
+    }
+
+    memset(bits, 0, depth_table::bytes);
+    uint64_t buffer = 0;
+    int have = 0;
+    size_t pos = 0;
+    for (int g = 0; g < table_groups; g++) {
+        if (have < max_code_length) {
+            // 4 more bytes at a time (zeros past the end, which only a cut short stream would reach)
+            for (int b = 0; b < 4; b++, pos++) buffer = (buffer << 8) | (pos < stream_size ? stream[pos] : 0);
+            have += 32;
+        }
+        uint16_t entry = lookup[(buffer >> (have - max_code_length)) & ((1 << max_code_length) - 1)];
+        have -= entry >> 8;
+
+        // group g = states 5g to 5g + 4 = bits 10g to 10g + 9, always within 2 bytes since 10g is even
+        size_t bit = 10 * (size_t) g;
+        uint32_t value = (uint32_t) packed[entry & 0xFF] << (bit & 7);
+        bits[bit >> 3] |= value;
+        bits[(bit >> 3) + 1] |= value >> 8;
+    }
+    return pos - have / 8 <= stream_size;
+}
+
+#if __has_include("depth_table_data.hpp")
+#include "depth_table_data.hpp" // generated by ./solver --embed-table depth_table_data.hpp
+#define SOLVER_EMBEDDED_TABLE
+#endif
+
+inline const vector<uint8_t> &get_embedded_table() {
+    // the depth table compiled into the binary, decoded once (empty if there is none, or it doesn't check out)
+    static const vector<uint8_t> table = [] {
+        vector<uint8_t> bits;
+#ifdef SOLVER_EMBEDDED_TABLE
+        bits.resize(depth_table::bytes);
+        if (!decompress_depth_table(embedded_code_lengths, embedded_stream, sizeof(embedded_stream), bits.data()) ||
+            table_checksum(bits.data(), bits.size()) != embedded_table_checksum) {
+            if (status_log) *status_log << "embedded depth table doesn't match its checksum, ignoring it\n";
+            bits.clear();
+        }
+#endif
+        return bits;
+    }();
+    return table;
+}
+
+struct ida_tables {
+    /*
+     * Pruning tables for the table-free engine
+     *
+     * perm_dist[p] = moves needed to solve just the permutation coordinate p (5040 entries)
+     * orie_dist[o] = moves needed to solve just the orientation coordinate o (729 entries)
+     *
+     * Solving the whole cube needs at least as many moves as either of them,
+     * so max(perm_dist, orie_dist) is an admissible heuristic for IDA*
+     * Both are BFS'd over the move tables, which takes well under a millisecond
+     */
+
+    array<uint8_t, 5040> perm_dist;
+    array<uint8_t, 729> orie_dist;
+
+    ida_tables() {
+        const move_tables &mt = get_move_tables();
+        coordinate_bfs(perm_dist.data(), 5040, [&mt](int p, int j) { return mt.perm_move[p][j]; });
+        coordinate_bfs(orie_dist.data(), 729, [&mt](int o, int j) { return mt.orie_move[o][j]; });
+    }
+
+    template <typename move_t>
+    static void coordinate_bfs(uint8_t *dist, int size, move_t move) {
+        fill(dist, dist + size, 0xFF);
+        dist[0] = 0;
+        queue<int> next;
+        next.push(0);
+        while (!next.empty()) {
+            int cur = next.front();
+            next.pop();
+            for (int j = 0; j < 9; j++) {
+                int adj = move(cur, j);
+                if (dist[adj] == 0xFF) {
+                    dist[adj] = dist[cur] + 1;
+                    next.push(adj);
+                }
+            }
+        }
+    }
+};
+
+inline const ida_tables &get_ida_tables() {
+    static const ida_tables tables;
+    return tables;
+}
+
+inline bool ida_search(int perm, int orie, int depth, int bound, int last_face, uint8_t *path) {
+    // depth first search with everything past the bound cut off by the pruning tables
+
+    const ida_tables &it = get_ida_tables();
+    const move_tables &mt = get_move_tables();
+    if (perm == 0 && orie == 0) return true;
+    if (depth + max(it.perm_dist[perm], it.orie_dist[orie]) > bound) return false;
+
+    for (int j = 0; j < 9; j++) {
+        if (j / 3 == last_face) continue; // F F2 etc. is never part of an optimal solution
+        path[depth] = j;
+        if (ida_search(mt.perm_move[perm][j], mt.orie_move[orie][j], depth + 1, bound, j / 3, path)) return true;
+    }
+    return false;
+}
+
+inline int ida_solution(int hash, uint8_t *moves) {
+    /*
+     * Table-free engine: iterative deepening A* with the coordinate pruning tables
+     * Needs ~6 KB of tables instead of the depth table, and the first bound that finds a solution is optimal
+     * Moves are tried in the same order as solution(), so the answers usually match it too
+     */
+
+    const ida_tables &it = get_ida_tables();
+    int perm = hash / 729;
+    int orie = hash % 729;
+    for (int bound = max(it.perm_dist[perm], it.orie_dist[orie]);; bound++) {
+        if (ida_search(perm, orie, 0, bound, -1, moves)) return bound;
+    }
+}
+
+/*
+ * Meet in the middle
+ *
+ * Only the states within k moves of solved are kept, as a sorted array of (hash << 4 | depth)
+ * with an index of where each range of hashes starts, so a lookup is a binary search over ~8 entries
+ * and the search goes forward from the scramble until it lands on one of them
+ *      k           4       5       6       7
+ *      states      2232    12224   62360   289896
+ *      memory      ~10 KB  ~51 KB  ~272 KB ~1.2 MB     (./solver --engine-bench N for the solve times)
+ * A state at depth D > k first reaches the set after exactly D - k moves, at a state of depth k,
+ * so the first hit is on an optimal solution, and the rest of it is walked down the stored depths
+ * The forward search is the IDA* above (same pruning tables), aimed at the set instead of at solved
+ */
+
+struct mitm_table {
+    int k = 0;
+    vector<uint32_t> entries;
+    vector<uint32_t> buckets;
+    int shift = 0;
+
+    void build(int max_depth) {
+        // BFS out to max_depth, the visited bits are only needed while building
+        const move_tables &mt = get_move_tables();
+        k = max_depth;
+        entries.assign(1, 0);
+        vector<bool> visited(states);
+        visited[0] = true;
+        vector<int> frontier = {0}, next;
+        for (int d = 1; d <= k && !frontier.empty(); d++) {
+            next.clear();
+            for (int cur : frontier) {
+                for (int j = 0; j < 9; j++) {
+                    int adj = mt.neighbour(cur, j);
+                    if (visited[adj]) continue;
+                    visited[adj] = true;
+                    next.push_back(adj);
+                    entries.push_back((uint32_t) adj << 4 | d);
+                }
+            }
+            swap(frontier, next);
+        }
+        sort(entries.begin(), entries.end());
+        entries.shrink_to_fit();
+
+        // where each run of 2^shift hashes starts in entries, ~8 entries per run on average
+        shift = 0;
+        while ((states >> shift) > (int) entries.size() / 8) shift++;
+        buckets.assign((states >> shift) + 2, 0);
+        for (uint32_t e : entries) buckets[(e >> 4 >> shift) + 1]++;
+        for (size_t b = 1; b < buckets.size(); b++) buckets[b] += buckets[b - 1];
+    }
+
+    int depth(int hash) const {
+        // -1 if hash is more than k moves from solved
+        auto first = entries.begin() + buckets[hash >> shift], last = entries.begin() + buckets[(hash >> shift) + 1];
+        auto it = lower_bound(first, last, (uint32_t) hash << 4);
+        return it != last && (int) (*it >> 4) == hash ? (int) (*it & 15) : -1;
+    }
+
+    size_t memory() const {
+        return (entries.size() + buckets.size()) * sizeof(uint32_t);
+    }
+};
+
+inline bool mitm_search(const mitm_table &table, int perm, int orie, int depth, int bound, int last_face,
+                        uint8_t *path, int &meet) {
+    // bound = forward moves, meet = the stored state the path ends on
+
+    const ida_tables &it = get_ida_tables();
+    const move_tables &mt = get_move_tables();
+    if (depth + max(it.perm_dist[perm], it.orie_dist[orie]) - table.k > bound) return false;
+    if (depth == bound) {
+        // the pruning tables already ruled out most states, only the rest are looked up
+        if (table.depth(perm * 729 + orie) < 0) return false;
+        meet = perm * 729 + orie;
+        return true;
+    }
+
+    for (int j = 0; j < 9; j++) {
+        if (j / 3 == last_face) continue;
+        path[depth] = j;
+        if (mitm_search(table, mt.perm_move[perm][j], mt.orie_move[orie][j], depth + 1, bound, j / 3, path, meet)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline int mitm_solution(const mitm_table &table, int hash, uint8_t *moves) {
+    const ida_tables &it = get_ida_tables();
+    const move_tables &mt = get_move_tables();
+    int perm = hash / 729;
+    int orie = hash % 729;
+    int meet = 0;
+    int length = max(0, max(it.perm_dist[perm], it.orie_dist[orie]) - table.k);
+    while (!mitm_search(table, perm, orie, 0, length, -1, moves, meet)) length++;
+
+    for (int d = table.depth(meet); d > 0; d--) {
+        for (int j = 0; j < 9; j++) {
+            int adj = mt.neighbour(meet, j);
+            if (table.depth(adj) == d - 1) {
+                moves[length++] = j;
+                meet = adj;
+                break;
+            }
+        }
+    }
+    return length;
+}
+
+/*
+ * Symmetry reduced table
+ *
+ * Turning the whole cube 120 degrees about the UBL-DFR diagonal (z y' or x y) leaves UBL where it is
+ * and turns R, F and D into each other. So for a rotation S, the conjugate S' * c * S of a cube c
+ * is another state of the same puzzle, with the same depth
+ * The mirror image through the plane that holds that diagonal and swaps R and F (see mirror_slow) does too,
+ * with every move turned the other way (R <-> F', D <-> D'), so with the rotations there are 6 symmetries
+ *      0 - 2 = rotations (none, z y', x y), 3 - 5 = the same rotation then the mirror
+ *
+ * Every state is mapped to a representative of its group of (up to) 6 conjugates:
+ * the permutation coordinate is conjugated to the smallest one of its class,
+ * and the orientation coordinate is conjugated along with it
+ * so only (perm classes) * 729 depths have to be stored, about a sixth of the flat table
+ *
+ * The orientation of a conjugate is the digit-wise (mod 3) sum of a part that only depends on the
+ * orientation coordinate and a part that only depends on the permutation coordinate
+ * (the mirror only permutes and negates digits, which keeps that true), so reducing a hash is a handful of table lookups
+ */
+
+struct sym_tables {
+    static constexpr int symmetries = 6;
+    array<cube, 3> rot;       // rotations as cubes, 0 = none
+    array<cube, 3> rot_inv;
+    array<array<uint16_t, 729>, symmetries> orie_conj;
+    array<array<uint16_t, 5040>, symmetries> perm_conj_orie;
+    array<array<uint8_t, 27>, 27> add3; // digit-wise addition of 3 digit ternary numbers
+    static constexpr uint8_t several = symmetries;
+    array<uint8_t, 5040> perm_sym;      // symmetry that takes a permutation to its class representative, or several
+    array<uint8_t, 5040> perm_syms;     // bit k set when symmetry k does (more than one = several)
+    array<uint16_t, 5040> perm_class;   // index of that representative
+    vector<uint16_t> class_perm;        // representative permutation of each class
+
+    static constexpr array<uint8_t, 8> mirror_position = {0, 3, 2, 1, 6, 5, 4, 7};
+    // the mirror swaps UBR <-> UFL and DFL <-> DBR, the other 4 corners stay
+
+    sym_tables() {
+        rot[0] = rot[1] = rot[2] = solved[0];
+        rot[1].apply_rotation(0); // z y'
+        rot[1].apply_rotation(8);
+        rot[2].apply_rotation(3); // x y
+        rot[2].apply_rotation(6);
+        rot_inv = {rot[0], rot[2], rot[1]};
+
+        for (int a = 0; a < 27; a++) {
+            for (int b = 0; b < 27; b++) {
+                add3[a][b] = 0;
+                for (int d = 1; d < 27; d *= 3) add3[a][b] += (a / d % 3 + b / d % 3) % 3 * d;
+            }
+        }
+
+        array<array<uint16_t, 5040>, symmetries> perm_conj;
+        for (int k = 0; k < symmetries; k++) {
+            for (int o = 0; o < 729; o++) orie_conj[k][o] = conjugate_slow(k, o);
+            for (int p = 0; p < 5040; p++) {
+                int h = conjugate_slow(k, p * 729);
+                perm_conj[k][p] = h / 729;
+                perm_conj_orie[k][p] = h % 729;
+            }
+        }
+
+        for (int p = 0; p < 5040; p++) {
+            int best = p;
+            for (int k = 0; k < symmetries; k++) best = min<int>(best, perm_conj[k][p]);
+            perm_syms[p] = 0;
+            for (int k = 0; k < symmetries; k++) {
+                if (perm_conj[k][p] == best) perm_syms[p] |= 1 << k;
+            }
+            perm_sym[p] = __builtin_popcount(perm_syms[p]) == 1 ? __builtin_ctz(perm_syms[p]) : several;
+            if (best == p) {
+                perm_class[p] = class_perm.size();
+                class_perm.push_back(p);
+            }
+        }
+        for (int p = 0; p < 5040; p++) {
+            int best = perm_conj[__builtin_ctz(perm_syms[p])][p];
+            perm_class[p] = perm_class[best];
+        }
+    }
+
+    static cube mirror_slow(const cube &c) {
+        // mirror image: pieces and positions swapped by the mirror, every twist the other way round
+        cube m = c;
+        for (int i = 0; i < 8; i++) {
+            m.pieces[mirror_position[i]] = mirror_position[c.pieces[i]];
+            m.orientations[mirror_position[i]] = (3 - c.orientations[i]) % 3;
+        }
+        return m;
+    }
+
+    int conjugate_slow(int k, int hash) const {
+        cube c = compose(compose(rot_inv[k % 3], unhash(hash)), rot[k % 3]);
+        return cube_hash(k < 3 ? c : mirror_slow(c));
+    }
+
+    int reduce(int hash) const {
+        // index of hash's representative in the symmetry reduced table
+        int p = hash / 729;
+        if (perm_sym[p] == several) {
+            // more than one symmetry gives the smallest permutation, so the smallest conjugated orientation decides
+            int best = 729;
+            for (unsigned ks = perm_syms[p]; ks; ks &= ks - 1) {
+                best = min(best, conjugate_orie(__builtin_ctz(ks), p, hash % 729));
+            }
+            return perm_class[p] * 729 + best;
+        }
+        return perm_class[p] * 729 + conjugate_orie(perm_sym[p], p, hash % 729);
+    }
+
+    int conjugate_orie(int k, int p, int o) const {
+        int a = orie_conj[k][o];
+        int b = perm_conj_orie[k][p];
+        return add3[a / 27][b / 27] * 27 + add3[a % 27][b % 27];
+    }
+
+    int entries() const {
+        return class_perm.size() * 729;
+    }
+
+    size_t memory() const {
+        return sizeof(*this) + class_perm.size() * sizeof(uint16_t);
+    }
+};
+
+inline const sym_tables &get_sym_tables() {
+    static const sym_tables tables;
+    return tables;
+}
+
+struct sym_depth_table {
+    // depth mod 3 of every representative, 2 bits each like depth_table, looked up through sym_tables::reduce
+
+    const uint8_t *bits = nullptr;
+
+    int get(int hash) const {
+        return depth_table::get(bits, get_sym_tables().reduce(hash));
+    }
+
+    static size_t bytes() {
+        return (get_sym_tables().entries() + 3) / 4;
+    }
+};
+
+struct sym_puzzle {
+    // the representatives as a puzzle for parallel_bfs: expand a representative, reduce its neighbours
+
+    static constexpr int state_count = states; // bound, representatives are numbered below sym_tables::entries()
+    static constexpr int move_count = 9;
+
+    const move_tables &mt = get_move_tables();
+    const sym_tables &st = get_sym_tables();
+
+    int neighbour(int rep, int move) const {
+        return st.reduce(mt.neighbour(st.class_perm[rep / 729] * 729 + rep % 729, move));
+    }
+};
+
+inline void make_sym_table(vector<uint8_t> &payload, int threads) {
+    uint8_t *bits = payload.data();
+    fill(payload.begin(), payload.end(), 0xFF);
+    depth_table::set(bits, 0, 0);
+
+    parallel_bfs(sym_puzzle(), threads, [bits](int adj, int depth) { return claim_depth(bits, adj, depth); }, print_layer);
+}
+
+inline bool open_sym_table(mapped_table &table_file, const string &path, int threads, string &error) {
+    return load_table(table_file, path, LAYOUT_SYM6, sym_depth_table::bytes(),
+                      [threads](vector<uint8_t> &payload) { make_sym_table(payload, threads); }, error);
+}
+
+/*
+ * Metrics
+ *
+ * Call counts and latency histograms for every stage of the solve path, plus a gauge for table memory
+ * Off by default: a stage_timer then costs one relaxed load and a branch, and records nothing
+ * json() and prometheus() give a snapshot of everything in either text format
+ */
+
+enum stage { STAGE_LOAD, STAGE_PARSE, STAGE_ORIENT, STAGE_HASH, STAGE_PATH, STAGE_FORMAT, STAGE_COUNT };
+const array<const char *, STAGE_COUNT> stage_names = {"load", "parse", "orient", "hash", "path", "format"};
+
+struct metrics {
+    static const int buckets = 40; // bucket b counts latencies under 2^b ns (and at least 2^(b-1) ns)
+
+    struct stage_stats {
+        atomic<uint64_t> count{0};
+        atomic<uint64_t> total_ns{0};
+        array<atomic<uint64_t>, buckets> histogram{};
+    };
+
+    atomic<bool> enabled{false};
+    array<stage_stats, STAGE_COUNT> stages;
+    atomic<uint64_t> table_bytes{0};
+
+    static uint64_t now_ns() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void record(stage s, uint64_t ns) {
+        stage_stats &st = stages[s];
+        st.count.fetch_add(1, memory_order_relaxed);
+        st.total_ns.fetch_add(ns, memory_order_relaxed);
+        int b = ns ? min(buckets - 1, 64 - __builtin_clzll(ns)) : 0;
+        st.histogram[b].fetch_add(1, memory_order_relaxed);
+    }
+
+    string json() const {
+        string out = "{\"table_bytes\":" + to_string(table_bytes.load()) + ",\"stages\":{";
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            const stage_stats &st = stages[s];
+            out += (s ? ",\"" : "\"") + string(stage_names[s]) + "\":{\"count\":" + to_string(st.count.load())
+                 + ",\"total_ns\":" + to_string(st.total_ns.load()) + ",\"histogram_ns\":{";
+            // only the buckets that have something in them, keyed by their upper bound
+            bool first = true;
+            for (int b = 0; b < buckets; b++) {
+                uint64_t n = st.histogram[b].load();
+                if (!n) continue;
+                out += (first ? "\"" : ",\"") + to_string(1ULL << b) + "\":" + to_string(n);
+                first = false;
+            }
+            out += "}}";
+        }
+        return out + "}}\n";
+    }
+
+    string prometheus() const {
+        string out = "# HELP solver_table_bytes Bytes of tables the engine reads while solving\n"
+                     "# TYPE solver_table_bytes gauge\n"
+                     "solver_table_bytes " + to_string(table_bytes.load()) + "\n"
+                     "# HELP solver_stage_seconds Time spent in each stage of the solve path\n"
+                     "# TYPE solver_stage_seconds histogram\n";
+        char line[512];
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            const stage_stats &st = stages[s];
+            uint64_t cumulative = 0;
+            for (int b = 0; b < buckets; b++) {
+                cumulative += st.histogram[b].load();
+                snprintf(line, sizeof(line), "solver_stage_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                         stage_names[s], (1ULL << b) * 1e-9, (unsigned long long) cumulative);
+                out += line;
+            }
+            snprintf(line, sizeof(line), "solver_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n"
+                                         "solver_stage_seconds_sum{stage=\"%s\"} %.9f\n"
+                                         "solver_stage_seconds_count{stage=\"%s\"} %llu\n",
+                     stage_names[s], (unsigned long long) st.count.load(),
+                     stage_names[s], st.total_ns.load() * 1e-9,
+                     stage_names[s], (unsigned long long) st.count.load());
+            out += line;
+        }
+        return out;
+    }
+};
+
+inline metrics solver_metrics;
+// one set for the whole process, so every solver and thread adds to the same numbers
+
+class stage_timer {
+    // times the scope it lives in into one stage (when metrics are on)
+
+    stage s;
+    uint64_t start;
+
+    public:
+        explicit stage_timer(stage s) : s(s), start(solver_metrics.enabled.load(memory_order_relaxed) ? metrics::now_ns() : 0) {}
+
+        ~stage_timer() {
+            if (start) solver_metrics.record(s, metrics::now_ns() - start);
+        }
+};
+
+struct solver {
+    /*
+     * Owns whichever table the engine needs, loaded once and only read after that
+     * so one solver can be shared between any number of threads
+     *
+     * name picks the engine: "graph", "depth", "sym", "ida" or "mitm"
+     * progressive = if the depth table has to be built, build it in the background and answer queries meanwhile
+     * (table.bits is only complete once building is done, see progressive_table)
+     *
+     * graph.bin is mapped after checking its header only, reading all 150 MB would be most of the start up,
+     * graph_check then checksums it while queries are answered and swaps in a rebuilt graph if it doesn't match
+     *
+     * table_dir = where the table files are read from and (re)built into
+     */
+
+    string name = "depth";
+    bool progressive = false;
+    string table_dir = ".";
+    mapped_table table_file;
+    mapped_table repaired_file; // the rebuilt graph, table_file stays mapped for solves that still use the old one
+    atomic<const graph_node *> graph{nullptr};
+    thread graph_check;
+    depth_table table;
+    sym_depth_table sym_table;
+    mitm_table mitm;
+    int mitm_depth = 6; // k for the "mitm" engine, memory against solve time (see mitm_table)
+    unique_ptr<progressive_table> building;
+
+    string table_path(const char *file) const {
+        return table_dir + "/" + file;
+    }
+
+    bool load(int threads, string &error) {
+        //Making graph (or loading it from disk), false with the reason if the table can't be loaded or built
+        stage_timer timer(STAGE_LOAD);
+        auto start_time = chrono::high_resolution_clock::now();
+        if (name == "graph") {
+            if (!open_graph(table_file, table_path("graph.bin"), threads, false, error)) return false;
+            graph = reinterpret_cast<const graph_node *>(table_file.payload());
+            graph_check = thread([this, threads] { check_graph(threads); });
+        }
+        else if (name == "depth") {
+            // compiled in table if there is one, no files needed then
+            table.bits = get_embedded_table().data();
+            string path = table_path("depth.bin");
+            if (!table.bits && progressive &&
+                !(table_file.open(path.c_str(), LAYOUT_DEPTH2, depth_table::bytes, error) && table_file.verify(error))) {
+                if (status_log && error != "missing") *status_log << path << " can't be used (" << error << "), rebuilding\n";
+                building = make_unique<progressive_table>();
+                if (building->start(path.c_str(), threads)) table.bits = building->data();
+                else building.reset();
+            }
+            if (!table.bits) {
+                if (!open_depth_table(table_file, path, threads, error)) return false;
+                table.bits = table_file.payload();
+            }
+        }
+        else if (name == "sym") {
+            if (!open_sym_table(table_file, table_path("sym.bin"), threads, error)) return false;
+            sym_table.bits = table_file.payload();
+        }
+        else if (name == "mitm") {
+            get_ida_tables();
+            mitm.build(mitm_depth);
+        }
+        else get_ida_tables();
+        solver_metrics.table_bytes = memory();
+        auto end_time = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+        if (!status_log) return true;
+        ostream &log = *status_log;
+        if (name == "ida") log << "Pruning tables built in " << duration.count() << " milliseconds\n";
+        else if (name == "mitm") log << "States within " << mitm.k << " moves of solved listed in " << duration.count()
+                                     << " milliseconds (" << mitm.memory() << " bytes)\n";
+        else if (building) log << "Table construction started in the background, answering queries meanwhile\n";
+        else if (!table_file.size()) log << "Embedded table decoded in " << duration.count() << " milliseconds\n";
+        else log << (name == "graph" ? "Graph" : "Table") << " construction complete in " << duration.count()
+                 << " milliseconds (" << table_file.size() << " bytes mapped)\n";
+        return true;
+    }
+
+    ~solver() {
+        if (graph_check.joinable()) graph_check.join();
+    }
+
+    void check_graph(int threads) {
+        // background half of loading graph.bin, see above
+        if (table_file.checksum_ok()) return;
+        string error;
+        if (!open_graph(repaired_file, table_path("graph.bin"), threads, true, error)) {
+            if (status_log) *status_log << error << ", still answering from the damaged graph\n";
+            return;
+        }
+        graph.store(reinterpret_cast<const graph_node *>(repaired_file.payload()), memory_order_release);
+        if (status_log) *status_log << "Rebuilt graph in use\n";
+    }
+
+    size_t memory() const {
+        // table bytes this engine reads while solving (besides the move tables every engine shares)
+        if (name == "ida") return sizeof(ida_tables);
+        if (name == "mitm") return sizeof(ida_tables) + mitm.memory();
+        if (name == "sym") return table_file.size() + get_sym_tables().memory();
+        if (name == "depth" && !table_file.size()) return depth_table::bytes;
+        return table_file.size();
+    }
+
+    static constexpr const char *no_solution = "error: the table has no solution for this cube (corrupt table, see --verify)";
+
+    int solve(int hash, uint8_t *moves) const {
+        // solving moves (0 - 8) for a hash of a white top green front cube, returns the number of moves (-1: corrupt table)
+        if (name == "graph") return solution(hash, graph.load(memory_order_acquire), moves);
+        if (name == "depth") return building ? building->solution(hash, moves) : solution(hash, table, moves);
+        if (name == "sym") return solution(hash, sym_table, moves);
+        if (name == "mitm") return mitm_solution(mitm, hash, moves);
+        return ida_solution(hash, moves);
+    }
+
+    void solve_batch(const int *hashes, int count, move_buffer *moves, int *lengths, int lanes = 8) const {
+        // solve() for many hashes at once, interleaved for the graph (~2x per core, see --interleave-bench)
+        // the depth table mostly stays in cache, so one at a time is faster there (and for the other engines)
+        if (name == "graph") interleaved_solutions(graph_walker{graph}, hashes, count, moves, lengths, lanes);
+        else for (int i = 0; i < count; i++) lengths[i] = solve(hashes[i], moves[i].data());
+    }
+
+    int depth(int hash) const {
+        // optimal solution length, straight from the graph or by walking the solution (any engine works)
+        if (name == "graph") return graph.load(memory_order_acquire)[hash].depth;
+        move_buffer moves;
+        return solve(hash, moves.data());
+    }
+
+    /*
+     * The cube and text entry points check solver_metrics.enabled once, up front:
+     * with metrics off that branch is all they cost (no stage_timer, no clock read),
+     * with them on the *_timed copies time every stage (kept out of line, cold, so the plain path stays small)
+     */
+
+    int solve(cube c, move_buffer &moves) const {
+        // optimal solution for c in the orientation c is held in (cube::apply_move indices), returns its length
+        // (-1 if the table has no solution for it, which only happens with a corrupt table)
+        if (__builtin_expect(solver_metrics.enabled.load(memory_order_relaxed), 0)) return solve_timed(c, moves);
+        int ort = c.find_orientation();
+        c.rotate_to_wca();
+        return to_orientation(ort, solve(cube_hash(c), moves.data()), moves);
+    }
+
+    string solve_scramble(string_view scramble) const {
+        // scramble (or 24 facelets) -> solution text in the same orientation the scramble was given in
+        if (__builtin_expect(solver_metrics.enabled.load(memory_order_relaxed), 0)) return solve_scramble_timed(scramble);
+        cube c = solved[0];
+        scramble_error error;
+        if (!read_scramble(scramble, c, error)) return "error at " + to_string(error.offset) + ": " + error.reason;
+        move_buffer moves;
+        int ort = c.find_orientation();
+        c.rotate_to_wca();
+        int length = to_orientation(ort, solve(cube_hash(c), moves.data()), moves);
+        return length < 0 ? no_solution : format_moves(moves.data(), length);
+    }
+
+    string solve_text(const cube &c) const {
+        // solution text for an already parsed cube, in the orientation it is held in
+        move_buffer moves;
+        int length = solve(c, moves);
+        stage_timer timer(STAGE_FORMAT);
+        if (length < 0) return no_solution;
+        return format_moves(moves.data(), length);
+    }
+
+    static int to_orientation(int ort, int length, move_buffer &moves) {
+        // moves of the white top green front solution -> the same turns for a cube held in orientation ort
+        const array<uint8_t, 9> &map = wca_move_maps[ort];
+        for (int i = 0; i < length; i++) moves[i] = map[moves[i]];
+        return length;
+    }
+
+    __attribute__((noinline, cold)) int solve_timed(cube c, move_buffer &moves) const {
+        int ort, hash;
+        {
+            stage_timer timer(STAGE_ORIENT);
+            ort = c.find_orientation();
+            c.rotate_to_wca();
+        }
+        {
+            stage_timer timer(STAGE_HASH);
+            hash = cube_hash(c);
+        }
+        stage_timer timer(STAGE_PATH);
+        return to_orientation(ort, solve(hash, moves.data()), moves);
+    }
+
+    __attribute__((noinline, cold)) string solve_scramble_timed(string_view scramble) const {
+        cube c = solved[0];
+        {
+            stage_timer timer(STAGE_PARSE);
+            scramble_error error;
+            if (!read_scramble(scramble, c, error)) return "error at " + to_string(error.offset) + ": " + error.reason;
+        }
+        return solve_text(c);
+    }
+
+    void solve_scrambles(const string_view *scrambles, int count, string *solutions) const {
+        // solve_scramble for a whole batch, solved together with solve_batch
+        // (with metrics on it goes one by one, so every stage is still timed per query)
+        if (solver_metrics.enabled.load(memory_order_relaxed)) {
+            for (int i = 0; i < count; i++) solutions[i] = solve_scramble_timed(scrambles[i]);
+            return;
+        }
+
+        thread_local vector<int> hashes, orientations, lengths;
+        thread_local vector<move_buffer> moves;
+        hashes.resize(count);
+        orientations.resize(count);
+        lengths.resize(count);
+        moves.resize(count);
+        for (int i = 0; i < count; i++) {
+            cube c = solved[0];
+            scramble_error error;
+            if (!read_scramble(scrambles[i], c, error)) {
+                solutions[i] = "error at " + to_string(error.offset) + ": " + error.reason;
+                hashes[i] = 0;
+                orientations[i] = -1;
+                continue;
+            }
+            orientations[i] = c.find_orientation();
+            c.rotate_to_wca();
+            hashes[i] = cube_hash(c);
+        }
+        solve_batch(hashes.data(), count, moves.data(), lengths.data());
+        for (int i = 0; i < count; i++) {
+            if (orientations[i] < 0) continue;
+            if (lengths[i] < 0) {
+                solutions[i] = no_solution;
+                continue;
+            }
+            solutions[i] = format_moves(moves[i].data(), to_orientation(orientations[i], lengths[i], moves[i]));
+        }
+    }
+
+    static bool read_scramble(string_view scramble, cube &c, scramble_error &error) {
+        // a scramble applied to c, or c set from 24 facelets
+        return looks_like_facelets(scramble) ? c.set_facelets(scramble, error) : c.apply_scramble(scramble, error);
+    }
+};
+
+/*
+ * Table verification
+ *
+ * The table files only have a checksum, which says the file is what was written, not that it is right
+ * (an older build with different move numbering would pass). Loading doesn't read it, so it's checked here first,
+ * then the tables are checked against the cube itself:
+ *      hashes: cube_hash(unhash(h)) == h for every state, and the batch versions (AVX2 when there is one) agree with them
+ *      moves: the move tables (and the graph's adjacency lists) agree with cube_hash(apply_move(unhash(h), j)) on every state
+ *      depths: exactly one state (solved) at depth 0, depths differ by at most 1 across every edge,
+ *              and every other state has a neighbour one closer, which together mean they're the real distances
+ * For the 2 bit tables the depths are the lengths of the walks solution() takes (so that's checked too),
+ * the ida and mitm engines have no full table, only the hash and move checks apply to them
+ */
+
+struct verify_report {
+    uint64_t hash_errors = 0;
+    uint64_t move_errors = 0;
+    uint64_t graph_errors = 0;
+    uint64_t depth_errors = 0;
+    uint64_t solved_states = 0;
+    bool depths_checked = false;
+    bool checksum_checked = false; // engine loaded from a table file
+    bool checksum_ok = true;
+    double milliseconds = 0;
+
+    bool ok() const {
+        return checksum_ok && !hash_errors && !move_errors && !graph_errors &&
+               (!depths_checked || (!depth_errors && solved_states == 1));
+    }
+};
+
+const int8_t unknown_length = 127;
+
+template <typename table_t>
+void walk_lengths(const table_t &table, int8_t *length, int begin, int end) {
+    /*
+     * length[h] = number of moves solution()'s walk takes from h, -1 if the walk gets stuck or goes past max_moves
+     * Walks stop at the first state whose length is already known, so every state is stepped from about once
+     * (other threads may be filling in the same states, always with the same values)
+     * length[] starts out as unknown_length everywhere except length[0] = 0
+     */
+
+    const move_tables &mt = get_move_tables();
+    auto known = [&](int h) { return __atomic_load_n(&length[h], __ATOMIC_RELAXED); };
+    array<int, max_moves + 1> walk;
+    for (int h = begin; h < end; h++) {
+        int steps = 0, cur = h, base = 0;
+        while ((base = known(cur)) == unknown_length) {
+            if (steps > max_moves) break;
+            walk[steps++] = cur;
+            int target = (table.get(cur) + 2) % 3, next = -1;
+            for (int i = 0; i < 9 && next < 0; i++) {
+                int adj = mt.neighbour(cur, i);
+                if (table.get(adj) == target) next = adj;
+            }
+            if (next < 0) break;
+            cur = next;
+        }
+        for (int i = 0; i < steps; i++) {
+            int l = base == unknown_length || base < 0 || base + steps - i > max_moves ? -1 : base + steps - i;
+            __atomic_store_n(&length[walk[i]], (int8_t) l, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+template <int move>
+void moved_copy(const cube *from, cube *to, int n) {
+    // move known at compile time, so apply_move folds down to the few swaps it does
+    for (int i = 0; i < n; i++) {
+        to[i] = from[i];
+        to[i].apply_move(move);
+    }
+}
+
+constexpr array<void (*)(const cube *, cube *, int), 9> moved_copies = {
+    moved_copy<0>, moved_copy<1>, moved_copy<2>, moved_copy<3>, moved_copy<4>,
+    moved_copy<5>, moved_copy<6>, moved_copy<7>, moved_copy<8>
+};
+
+inline verify_report verify_engine(const solver &engine, int threads) {
+    // every check over every state, in chunks across the threads
+    auto start_time = chrono::high_resolution_clock::now();
+    const move_tables &mt = get_move_tables();
+    const int chunk_size = 4096;
+    const int chunks = (states + chunk_size - 1) / chunk_size;
+    verify_report report;
+    atomic<uint64_t> hash_errors(0), move_errors(0), graph_errors(0), depth_errors(0), solved_states(0);
+    const graph_node *graph = engine.graph.load(memory_order_acquire); // the same graph throughout
+
+    report.checksum_checked = engine.table_file.size() != 0;
+    if (report.checksum_checked) report.checksum_ok = engine.table_file.checksum_ok();
+    report.depths_checked = engine.name == "graph" || engine.name == "depth" || engine.name == "sym";
+    vector<int8_t> depth(report.depths_checked ? states : 0, unknown_length);
+    if (report.depths_checked) depth[0] = 0;
+
+    parallel_for(threads, chunks, [&](int chunk) {
+        // the scalar unhash/cube_hash (what solving uses) are the reference, the batch versions are checked against them
+        thread_local vector<int> hashes(chunk_size), adj(chunk_size);
+        thread_local vector<cube> cubes(chunk_size), batch_cubes(chunk_size), moved(chunk_size);
+        uint64_t hash_bad = 0, move_bad = 0, graph_bad = 0;
+        int begin = chunk * chunk_size;
+        int n = min(states, begin + chunk_size) - begin;
+
+        for (int i = 0; i < n; i++) {
+            hashes[i] = begin + i;
+            cubes[i] = unhash(begin + i);
+        }
+        unhash_batch(hashes.data(), n, batch_cubes.data());
+        hash_batch(cubes.data(), n, adj.data());
+        for (int i = 0; i < n; i++) {
+            hash_bad += cube_hash(cubes[i]) != begin + i || adj[i] != begin + i ||
+                        batch_cubes[i].pieces != cubes[i].pieces || batch_cubes[i].orientations != cubes[i].orientations;
+        }
+        for (int j = 0; j < 9; j++) {
+            moved_copies[j](cubes.data(), moved.data(), n);
+            hash_batch(moved.data(), n, adj.data());
+            for (int i = 0; i < n; i++) {
+                int h = cube_hash(moved[i]);
+                hash_bad += adj[i] != h;
+                move_bad += mt.neighbour(begin + i, j) != h;
+                if (graph) graph_bad += graph[begin + i].adj[j] != h;
+            }
+        }
+
+        if (engine.name == "graph") {
+            for (int h = begin; h < begin + n; h++) depth[h] = graph[h].depth <= max_moves ? graph[h].depth : -1;
+        }
+        else if (engine.name == "depth") walk_lengths(engine.table, depth.data(), begin, begin + n);
+        else if (engine.name == "sym") walk_lengths(engine.sym_table, depth.data(), begin, begin + n);
+        hash_errors += hash_bad;
+        move_errors += move_bad;
+        graph_errors += graph_bad;
+    });
+
+    if (report.depths_checked) {
+        parallel_for(threads, chunks, [&](int chunk) {
+            uint64_t bad = 0, solved = 0;
+            int end = min(states, (chunk + 1) * chunk_size);
+            for (int h = chunk * chunk_size; h < end; h++) {
+                int d = depth[h];
+                if (d < 0) {
+                    bad++;
+                    continue;
+                }
+                solved += d == 0;
+                bool closer = d == 0;
+                for (int j = 0; j < 9; j++) {
+                    int e = depth[mt.neighbour(h, j)];
+                    if (e < 0) continue; // counted as bad on its own
+                    bad += e > d + 1 || e < d - 1;
+                    closer |= e == d - 1;
+                }
+                bad += !closer;
+            }
+            depth_errors += bad;
+            solved_states += solved;
+        });
+    }
+
+    report.hash_errors = hash_errors;
+    report.move_errors = move_errors;
+    report.graph_errors = graph_errors;
+    report.depth_errors = depth_errors;
+    report.solved_states = solved_states;
+    report.milliseconds = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start_time).count();
+    return report;
+}
+
+#endif